@@ -0,0 +1,432 @@
+// 渲染管线基准：在 offscreen 平台上驱动 HeatMapOverlay，覆盖点数、控件尺寸、半径、
+// 缩放模式与自动归一化的参数网格，结果写成 JSON，便于与保存的基线比较
+// （见 scripts/compare_bench.py）。
+//
+// 用法：
+//   heatmap_bench [--json 结果.json] [QTest 参数，如 fullFrame 或 fullFrame:100k/4K/r48/cover/norm]
+// 未指定 --json 时写入当前目录的 heatmap_bench.json。
+// steadyStateAllocations 不计时，只检查固定尺寸下逐个追加点击或推进回放的稳态帧没有堆分配，
+// 包括放大视口时的瓦片缓存。
+// 默认构建只统计经由 operator new 的分配；以 HEATMAP_ENABLE_INSTRUMENTATION=ON 构建时
+// 另外检查渲染器内 Qt 容器与 QImage 缓冲（malloc）的新分配次数。
+
+#include <QApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QThread>
+#include <QtTest>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#include "../src/HeatMapOverlay.h"
+
+namespace {
+
+// 每行至少运行的次数与时间，以及次数上限
+constexpr int kMinIterations = 3;
+constexpr int kMaxIterations = 50;
+constexpr qint64 kMinTimeMs = 200;
+
+constexpr int kMaxPoints = 1000000;
+
+// 稳态分配检查：预先载入的点数、测量帧数与预热帧数，点击的时间间隔与滑动窗口（兼作衰减半衰期）
+constexpr int kSteadyStatePreloaded = 1000;
+constexpr int kSteadyStateCycles = 200;
+constexpr int kWarmUpCycles = 16;
+constexpr qint64 kSteadyStateStepMs = 10;
+constexpr int kSteadyStateWindowMs = 2000;
+// 增量帧中可能并行调度的阶段数：归一化的瓦片最大值、重采样与着色
+constexpr int kMaxParallelDispatchesPerFrame = 3;
+
+// 经由全局 operator new 的分配次数（std::function、智能指针、标准容器、Qt 对象的私有数据等）。
+// Qt 容器与 QImage 的缓冲直接使用 malloc，不在此计数，由渲染统计的 allocations 覆盖
+std::atomic<qint64> g_operatorNewCount{0};
+
+struct Row
+{
+    int points = 0;
+    QSize size;
+    int radius = 0;
+    HeatMapOverlay::ScaleMode scaleMode = HeatMapOverlay::CoverWidget;
+    bool autoNormalize = true;
+};
+
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    g_operatorNewCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+Q_DECLARE_METATYPE(HeatMapOverlay::ScaleMode)
+Q_DECLARE_METATYPE(HeatMapOverlay::TimeMode)
+
+class HeatMapBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HeatMapBench(const QString &jsonPath)
+        : m_jsonPath(jsonPath)
+    {
+    }
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    // 整帧重建：密度累积、归一化、着色与合成
+    void fullFrame_data() { addGrid(); }
+    void fullFrame();
+    // 只换颜色：调色板重建与查表着色
+    void recolor_data() { addGrid(); }
+    void recolor();
+    // 切换自动归一化：归一化与着色
+    void normalize_data() { addGrid(); }
+    void normalize();
+    // 只重绘：背景缓存与热力图的合成（paintEvent）
+    void paint_data() { addGrid(); }
+    void paint();
+    // 稳态分配：固定尺寸下反复追加单个点击或推进回放位置并完成渲染，渲染管线不应有堆分配
+    void steadyStateAllocations_data();
+    void steadyStateAllocations();
+
+private:
+    void addGrid();
+    Row fetchRow() const;
+    void setUp(HeatMapOverlay &overlay, const Row &row) const;
+    template <typename Fn>
+    void measure(const Row &row, Fn &&iteration);
+
+    QString m_jsonPath;
+    QImage m_baseImage;
+    QVector<HeatMapPoint> m_points;
+    QJsonArray m_results;
+};
+
+void HeatMapBench::initTestCase()
+{
+    // 固定的合成背景与聚簇点击，生成方式与平台无关，便于跨机器比较
+    m_baseImage = QImage(1920, 1080, QImage::Format_RGB32);
+    QPainter painter(&m_baseImage);
+    QLinearGradient gradient(0, 0, m_baseImage.width(), m_baseImage.height());
+    gradient.setColorAt(0.0, QColor(40, 40, 48));
+    gradient.setColorAt(1.0, QColor(200, 200, 210));
+    painter.fillRect(m_baseImage.rect(), gradient);
+    painter.end();
+
+    static const QPointF clusters[] = {{0.2, 0.2}, {0.5, 0.3}, {0.8, 0.2}, {0.3, 0.6},
+                                       {0.6, 0.7}, {0.85, 0.8}, {0.15, 0.85}, {0.5, 0.5}};
+    std::mt19937 random(20240601);
+    auto uniform = [&random]() { return random() / 4294967296.0; };
+    m_points.reserve(kMaxPoints);
+    for (int i = 0; i < kMaxPoints; ++i) {
+        const QPointF center = clusters[random() % std::size(clusters)];
+        const qreal dx = (uniform() + uniform() + uniform() - 1.5) * 0.1;
+        const qreal dy = (uniform() + uniform() + uniform() - 1.5) * 0.1;
+        m_points.append({QPointF(qBound(0.0, center.x() + dx, 1.0), qBound(0.0, center.y() + dy, 1.0)), 1.0, 0});
+    }
+}
+
+void HeatMapBench::cleanupTestCase()
+{
+    QJsonObject document;
+    document.insert(QStringLiteral("benchmark"), QStringLiteral("heatmap_bench"));
+    document.insert(QStringLiteral("qtVersion"), QString::fromLatin1(qVersion()));
+    document.insert(QStringLiteral("threads"), QThread::idealThreadCount());
+    document.insert(QStringLiteral("results"), m_results);
+
+    QFile file(m_jsonPath);
+    QVERIFY2(file.open(QIODevice::WriteOnly | QIODevice::Truncate), qPrintable(file.errorString()));
+    file.write(QJsonDocument(document).toJson(QJsonDocument::Indented));
+}
+
+void HeatMapBench::addGrid()
+{
+    QTest::addColumn<int>("points");
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("radius");
+    QTest::addColumn<HeatMapOverlay::ScaleMode>("scaleMode");
+    QTest::addColumn<bool>("autoNormalize");
+
+    const QList<QPair<QString, int>> pointCounts = {
+        {QStringLiteral("10"), 10}, {QStringLiteral("1k"), 1000}, {QStringLiteral("100k"), 100000}, {QStringLiteral("1M"), kMaxPoints}};
+    const QList<QPair<QString, QSize>> sizes = {{QStringLiteral("720p"), QSize(1280, 720)},
+                                                {QStringLiteral("1080p"), QSize(1920, 1080)},
+                                                {QStringLiteral("4K"), QSize(3840, 2160)},
+                                                {QStringLiteral("8K"), QSize(7680, 4320)}};
+    const QList<int> radii = {16, 48};
+    for (const auto &points : pointCounts) {
+        for (const auto &size : sizes) {
+            for (int radius : radii) {
+                for (HeatMapOverlay::ScaleMode mode : {HeatMapOverlay::FitInside, HeatMapOverlay::CoverWidget}) {
+                    for (bool normalize : {true, false}) {
+                        const QString tag = QStringLiteral("%1/%2/r%3/%4/%5")
+                                                .arg(points.first, size.first)
+                                                .arg(radius)
+                                                .arg(mode == HeatMapOverlay::FitInside ? QStringLiteral("fit")
+                                                                                       : QStringLiteral("cover"))
+                                                .arg(normalize ? QStringLiteral("norm") : QStringLiteral("raw"));
+                        QTest::newRow(qPrintable(tag)) << points.second << size.second << radius << mode << normalize;
+                    }
+                }
+            }
+        }
+    }
+}
+
+Row HeatMapBench::fetchRow() const
+{
+    QFETCH(int, points);
+    QFETCH(QSize, size);
+    QFETCH(int, radius);
+    QFETCH(HeatMapOverlay::ScaleMode, scaleMode);
+    QFETCH(bool, autoNormalize);
+    return {points, size, radius, scaleMode, autoNormalize};
+}
+
+void HeatMapBench::setUp(HeatMapOverlay &overlay, const Row &row) const
+{
+    overlay.resize(row.size);
+    overlay.setBaseImage(m_baseImage);
+    overlay.setPointRadius(row.radius);
+    overlay.setScaleMode(row.scaleMode);
+    overlay.setAutoNormalize(row.autoNormalize);
+    overlay.addClicks(QSpan<const HeatMapPoint>(m_points.constData(), row.points));
+    overlay.waitForIdle();
+}
+
+template <typename Fn>
+void HeatMapBench::measure(const Row &row, Fn &&iteration)
+{
+    // 预热一次：首帧包含缓冲分配与背景缩放
+    iteration();
+
+    QVector<qint64> samples;
+    QElapsedTimer total;
+    total.start();
+    while (samples.size() < kMinIterations || (total.elapsed() < kMinTimeMs && samples.size() < kMaxIterations)) {
+        QElapsedTimer timer;
+        timer.start();
+        iteration();
+        samples.append(timer.nsecsElapsed());
+    }
+    std::sort(samples.begin(), samples.end());
+    qint64 sum = 0;
+    for (qint64 sample : std::as_const(samples))
+        sum += sample;
+
+    const double medianMs = samples.at(samples.size() / 2) / 1e6;
+    QTest::setBenchmarkResult(medianMs, QTest::WalltimeMilliseconds);
+
+    QJsonObject result;
+    result.insert(QStringLiteral("name"), QString::fromLatin1(QTest::currentTestFunction()));
+    result.insert(QStringLiteral("row"), QString::fromLatin1(QTest::currentDataTag()));
+    result.insert(QStringLiteral("points"), row.points);
+    result.insert(QStringLiteral("width"), row.size.width());
+    result.insert(QStringLiteral("height"), row.size.height());
+    result.insert(QStringLiteral("radius"), row.radius);
+    result.insert(QStringLiteral("scaleMode"),
+                  row.scaleMode == HeatMapOverlay::FitInside ? QStringLiteral("fit") : QStringLiteral("cover"));
+    result.insert(QStringLiteral("autoNormalize"), row.autoNormalize);
+    result.insert(QStringLiteral("iterations"), int(samples.size()));
+    result.insert(QStringLiteral("minMs"), samples.first() / 1e6);
+    result.insert(QStringLiteral("medianMs"), medianMs);
+    result.insert(QStringLiteral("meanMs"), sum / 1e6 / samples.size());
+    m_results.append(result);
+}
+
+void HeatMapBench::fullFrame()
+{
+    const Row row = fetchRow();
+    HeatMapOverlay overlay;
+    setUp(overlay, row);
+    QImage target(row.size, QImage::Format_ARGB32_Premultiplied);
+    const QSpan<const HeatMapPoint> points(m_points.constData(), row.points);
+
+    measure(row, [&]() {
+        overlay.clearClicks();
+        overlay.addClicks(points);
+        overlay.waitForIdle();
+        overlay.render(&target);
+    });
+}
+
+void HeatMapBench::recolor()
+{
+    const Row row = fetchRow();
+    HeatMapOverlay overlay;
+    setUp(overlay, row);
+    QImage target(row.size, QImage::Format_ARGB32_Premultiplied);
+    bool alternate = false;
+
+    measure(row, [&]() {
+        alternate = !alternate;
+        overlay.setHotColor(alternate ? QColor(255, 200, 0) : QColor(255, 0, 0));
+        overlay.waitForIdle();
+        overlay.render(&target);
+    });
+}
+
+void HeatMapBench::normalize()
+{
+    const Row row = fetchRow();
+    HeatMapOverlay overlay;
+    setUp(overlay, row);
+    QImage target(row.size, QImage::Format_ARGB32_Premultiplied);
+
+    measure(row, [&]() {
+        overlay.setAutoNormalize(!overlay.autoNormalize());
+        overlay.waitForIdle();
+        overlay.render(&target);
+    });
+}
+
+void HeatMapBench::paint()
+{
+    const Row row = fetchRow();
+    HeatMapOverlay overlay;
+    setUp(overlay, row);
+    QImage target(row.size, QImage::Format_ARGB32_Premultiplied);
+
+    measure(row, [&]() { overlay.render(&target); });
+}
+
+void HeatMapBench::steadyStateAllocations_data()
+{
+    QTest::addColumn<bool>("playback");
+    QTest::addColumn<HeatMapOverlay::TimeMode>("timeMode");
+    QTest::addColumn<int>("threads"); // 0 表示按 CPU 核数
+    QTest::addColumn<qreal>("zoom");  // 大于 1 时经由瓦片缓存绘制放大的视口
+
+    QTest::newRow("append/allTime/1thread") << false << HeatMapOverlay::AllTime << 1 << 1.0;
+    QTest::newRow("append/allTime/threads") << false << HeatMapOverlay::AllTime << 0 << 1.0;
+    QTest::newRow("append/window/1thread") << false << HeatMapOverlay::SlidingWindow << 1 << 1.0;
+    QTest::newRow("playback/window/1thread") << true << HeatMapOverlay::SlidingWindow << 1 << 1.0;
+    QTest::newRow("playback/window/threads") << true << HeatMapOverlay::SlidingWindow << 0 << 1.0;
+    QTest::newRow("playback/decay/1thread") << true << HeatMapOverlay::ExponentialDecay << 1 << 1.0;
+    QTest::newRow("zoom/append/window/1thread") << false << HeatMapOverlay::SlidingWindow << 1 << 4.0;
+    QTest::newRow("zoom/playback/window/1thread") << true << HeatMapOverlay::SlidingWindow << 1 << 4.0;
+}
+
+void HeatMapBench::steadyStateAllocations()
+{
+    QFETCH(bool, playback);
+    QFETCH(HeatMapOverlay::TimeMode, timeMode);
+    QFETCH(int, threads);
+    QFETCH(qreal, zoom);
+
+    HeatMapOverlay overlay;
+    overlay.setWorkerThreadCount(threads);
+    overlay.setTimeMode(timeMode);
+    overlay.setTimeWindow(kSteadyStateWindowMs);
+    overlay.setDecayHalfLife(kSteadyStateWindowMs);
+    overlay.resize(QSize(1280, 720));
+    overlay.setBaseImage(m_baseImage);
+    overlay.setPointRadius(25);
+    overlay.setZoom(zoom);
+
+    // 点击按固定间隔带时间戳。追加场景的时间戳截止到当前时间，保证落在滑动窗口内；
+    // 回放场景预先载入全部点击，之后每帧把回放位置前移一个间隔
+    const int loaded = playback ? kSteadyStatePreloaded + kWarmUpCycles + kSteadyStateCycles : kSteadyStatePreloaded;
+    const qint64 origin =
+        playback ? 0 : QDateTime::currentMSecsSinceEpoch() - qint64(kSteadyStatePreloaded) * kSteadyStateStepMs;
+    QVector<HeatMapPoint> points(m_points.cbegin(), m_points.cbegin() + loaded);
+    for (int i = 0; i < loaded; ++i)
+        points[i].timestamp = origin + qint64(i) * kSteadyStateStepMs;
+    overlay.addClicks(QSpan<const HeatMapPoint>(points.constData(), points.size()));
+    overlay.waitForIdle();
+    QImage target(overlay.size(), QImage::Format_ARGB32_Premultiplied);
+
+    // 一帧：追加一个点击，或前移回放位置（进入与滑出窗口各一个点）
+    auto advance = [&](int i) {
+        const qint64 timestamp = origin + qint64(kSteadyStatePreloaded + i) * kSteadyStateStepMs;
+        if (playback)
+            overlay.seek(timestamp);
+        else
+            overlay.addClick(m_points.at(kSteadyStatePreloaded + i).pos, 1.0, timestamp);
+        overlay.waitForIdle();
+    };
+
+    // 预热：时间戳列、核印章的亚像素相位、线程池线程与并行调度状态、视口内的瓦片等在前几帧就绪，
+    // 之后预留点击存储
+    for (int i = 0; i < kWarmUpCycles; ++i) {
+        advance(i);
+        overlay.render(&target);
+    }
+    if (!playback)
+        overlay.reserveClicks(overlay.points().size() + kSteadyStateCycles);
+
+    // 借用线程池线程时，QThreadPool 内部为排队的任务分配少量内存，每次并行调度每个借用线程至多一次
+    const int helpers = qMax(0, (threads > 0 ? threads : QThread::idealThreadCount()) - 1);
+    const qint64 allowed = qint64(kSteadyStateCycles) * kMaxParallelDispatchesPerFrame * helpers;
+    qint64 allocations = 0;
+    for (int i = kWarmUpCycles; i < kWarmUpCycles + kSteadyStateCycles; ++i) {
+        const qint64 before = g_operatorNewCount.load(std::memory_order_relaxed);
+        advance(i);
+        allocations += g_operatorNewCount.load(std::memory_order_relaxed) - before;
+        // 合成中 QPainter 自身的分配不在渲染管线之内，不计入。放大后瓦片在绘制时更新：
+        // 本帧合成的分配减去随即重复合成（瓦片已是最新，只有 QPainter 的分配）的分配，即为瓦片缓存的分配
+        const qint64 beforePaint = g_operatorNewCount.load(std::memory_order_relaxed);
+        overlay.render(&target);
+#ifdef HEATMAP_INSTRUMENTATION
+        QCOMPARE(overlay.frameStats().allocations, 0);
+#endif
+        if (zoom > 1.0) {
+            const qint64 painted = g_operatorNewCount.load(std::memory_order_relaxed) - beforePaint;
+            overlay.render(&target);
+            const qint64 repainted = g_operatorNewCount.load(std::memory_order_relaxed) - beforePaint - painted;
+            allocations += painted - repainted;
+        }
+    }
+    QVERIFY2(allocations <= allowed,
+             qPrintable(QStringLiteral("%1 帧共经由 operator new 分配 %2 次，上限 %3 次")
+                            .arg(kSteadyStateCycles)
+                            .arg(allocations)
+                            .arg(allowed)));
+}
+
+int main(int argc, char *argv[])
+{
+    // 无显示环境的服务器上使用 offscreen 平台
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    // --json 由本程序处理，其余参数原样交给 QTest
+    QString jsonPath = QStringLiteral("heatmap_bench.json");
+    QStringList testArguments;
+    for (int i = 0; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = QString::fromLocal8Bit(argv[++i]);
+        else
+            testArguments.append(QString::fromLocal8Bit(argv[i]));
+    }
+
+    QApplication app(argc, argv);
+    HeatMapBench bench(jsonPath);
+    return QTest::qExec(&bench, testArguments);
+}
+
+#include "heatmap_bench.moc"
@@ -11,6 +11,7 @@
 #include <QComboBox>
 #include <QMouseEvent>
 #include <QEvent>
+#include <QSignalBlocker>
 #include "../src/HeatMapOverlay.h"
 
 // Demo 程序：载入背景图片，录入点击并实时展示热力图
@@ -24,6 +25,8 @@ int main(int argc, char *argv[])
 
     auto *overlay = new HeatMapOverlay();
     overlay->setNormalizedCoordinates(true);
+    // 滚轮缩放、中键/右键拖动平移，左键仍用于录入点击
+    overlay->setInteractiveViewport(true);
 
     QVBoxLayout *rootLayout = new QVBoxLayout();
 
@@ -67,10 +70,36 @@ int main(int argc, char *argv[])
     QPushButton *clearBtn = new QPushButton(QStringLiteral("清除点击记录"));
     controlLayout->addWidget(clearBtn);
 
+    QPushButton *resetViewBtn = new QPushButton(QStringLiteral("重置视图"));
+    controlLayout->addWidget(resetViewBtn);
+
     controlLayout->addStretch();
 
     rootLayout->addLayout(controlLayout);
 
+    // 时间轴回放：滑块 0~1000 映射到第一个与最后一个点击之间
+    QHBoxLayout *playbackLayout = new QHBoxLayout();
+
+    QPushButton *playBtn = new QPushButton(QStringLiteral("播放"));
+    playbackLayout->addWidget(playBtn);
+
+    QPushButton *stopPlaybackBtn = new QPushButton(QStringLiteral("退出回放"));
+    playbackLayout->addWidget(stopPlaybackBtn);
+
+    QSlider *timelineSlider = new QSlider(Qt::Horizontal);
+    timelineSlider->setRange(0, 1000);
+    playbackLayout->addWidget(timelineSlider, 1);
+
+    QLabel *speedLabel = new QLabel(QStringLiteral("速度"));
+    QComboBox *speedCombo = new QComboBox();
+    for (qreal speed : {0.5, 1.0, 2.0, 5.0, 10.0, 50.0})
+        speedCombo->addItem(QStringLiteral("%1×").arg(speed), speed);
+    speedCombo->setCurrentIndex(1);
+    playbackLayout->addWidget(speedLabel);
+    playbackLayout->addWidget(speedCombo);
+
+    rootLayout->addLayout(playbackLayout);
+
     // 使用 QFrame 包裹 overlay，支持鼠标点击录入
     QFrame *frame = new QFrame();
     frame->setFrameShape(QFrame::StyledPanel);
@@ -103,6 +132,35 @@ int main(int argc, char *argv[])
     QObject::connect(adaptiveRadiusBox, &QCheckBox::toggled, overlay, &HeatMapOverlay::setAdaptivePointRadius);
     QObject::connect(crosshairBox, &QCheckBox::toggled, overlay, &HeatMapOverlay::setShowCrosshair);
     QObject::connect(clearBtn, &QPushButton::clicked, overlay, &HeatMapOverlay::clearClicks);
+    QObject::connect(resetViewBtn, &QPushButton::clicked, overlay, &HeatMapOverlay::resetViewport);
+
+    QObject::connect(playBtn, &QPushButton::clicked, [&]() {
+        if (overlay->isPlaying())
+            overlay->pause();
+        else
+            overlay->play();
+    });
+    QObject::connect(stopPlaybackBtn, &QPushButton::clicked, overlay, &HeatMapOverlay::stopPlayback);
+    QObject::connect(overlay, &HeatMapOverlay::playbackStateChanged, [&]() {
+        playBtn->setText(overlay->isPlaying() ? QStringLiteral("暂停") : QStringLiteral("播放"));
+    });
+    // 拖动、点击滑轨与键盘都会改变数值；回放推进时的回写由 QSignalBlocker 屏蔽，不会触发跳转
+    QObject::connect(timelineSlider, &QSlider::valueChanged, [&](int value) {
+        const qint64 start = overlay->playbackStartTime();
+        overlay->seek(start + (overlay->playbackEndTime() - start) * value / 1000);
+    });
+    QObject::connect(overlay, &HeatMapOverlay::playbackPositionChanged, [&](qint64 position) {
+        const qint64 start = overlay->playbackStartTime();
+        const qint64 span = overlay->playbackEndTime() - start;
+        // 拖动时不回写，避免滑块抖动
+        if (span > 0 && !timelineSlider->isSliderDown()) {
+            const QSignalBlocker blocker(timelineSlider);
+            timelineSlider->setValue(static_cast<int>((position - start) * 1000 / span));
+        }
+    });
+    QObject::connect(speedCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), [&](int index) {
+        overlay->setPlaybackSpeed(speedCombo->itemData(index).toDouble());
+    });
 
     // 自定义事件过滤器，记录点击点
     class ClickFilter : public QObject {
@@ -114,7 +172,8 @@ int main(int argc, char *argv[])
             if (watched == m_target && event->type() == QEvent::MouseButtonPress) {
                 QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
                 QPointF pos = mouseEvent->position();
-                QPointF overlayPos = m_overlay->mapFrom(m_target, pos.toPoint());
+                // 缩放视口下先换算回未缩放的画面坐标
+                QPointF overlayPos = m_overlay->mapToContent(m_overlay->mapFrom(m_target, pos.toPoint()));
                 QRectF rect = m_overlay->displayRect();
                 if (rect.contains(overlayPos) && rect.width() > 0 && rect.height() > 0) {
                     // 将坐标归一化到实际背景区域，保证更换图片或缩放后依然对应正确位置
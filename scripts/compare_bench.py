@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+import argparse
+import json
+import sys
+from typing import Dict, Tuple
+
+# 比较两次 heatmap_bench 的 JSON 结果：按 (基准名, 参数行) 配对，
+# 中位数耗时变慢超过阈值的行视为回归，存在回归时以非零状态退出。
+
+Key = Tuple[str, str]
+
+
+def load_results(path: str) -> Dict[Key, dict]:
+    with open(path, "r", encoding="utf-8") as f:
+        document = json.load(f)
+    return {(r["name"], r["row"]): r for r in document.get("results", [])}
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="比较 heatmap_bench 结果与基线")
+    parser.add_argument("baseline", help="基线 JSON")
+    parser.add_argument("current", help="本次 JSON")
+    parser.add_argument("--threshold", type=float, default=0.10, help="允许的相对变慢比例（默认 0.10）")
+    args = parser.parse_args()
+
+    baseline = load_results(args.baseline)
+    current = load_results(args.current)
+
+    regressions = 0
+    for key in sorted(baseline.keys() & current.keys()):
+        before = baseline[key]["medianMs"]
+        after = current[key]["medianMs"]
+        change = (after - before) / before if before > 0 else 0.0
+        marker = ""
+        if change > args.threshold:
+            marker = "  <-- 回归"
+            regressions += 1
+        print(f"{key[0]:<10} {key[1]:<28} {before:10.3f} ms -> {after:10.3f} ms  {change:+7.1%}{marker}")
+
+    for key in sorted(current.keys() - baseline.keys()):
+        print(f"{key[0]:<10} {key[1]:<28} 新增")
+    for key in sorted(baseline.keys() - current.keys()):
+        print(f"{key[0]:<10} {key[1]:<28} 缺失")
+
+    print(f"{regressions} 项回归（阈值 {args.threshold:.0%}）")
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,356 @@
+#include "HeatMapClickLog.h"
+
+#include <QSaveFile>
+#include <QSysInfo>
+
+#include <cstring>
+#include <limits>
+
+namespace HeatMapClickLog {
+
+namespace {
+
+constexpr quint16 kVersion = 1;
+constexpr quint32 kNormalizedCoordinatesFlag = 0x1;
+
+// 数据块的编码标志
+constexpr quint32 kCompactCoordinatesFlag = 0x1;
+constexpr quint32 kHasWeightsFlag = 0x2;
+constexpr quint32 kCompactWeightsFlag = 0x4;
+constexpr quint32 kHasTimestampsFlag = 0x8;
+
+struct FileHeader
+{
+    char magic[4];
+    quint16 version;
+    quint16 headerSize;
+    quint32 flags;
+    quint32 baseWidth;
+    quint32 baseHeight;
+    quint32 reserved[3];
+};
+
+struct BlockHeader
+{
+    char magic[4];
+    quint32 count;
+    quint32 flags;
+    quint32 reserved;
+    qint64 timeBase;
+};
+
+static_assert(sizeof(FileHeader) == 32 && sizeof(BlockHeader) == 24, "点击日志头部布局不能有填充");
+
+constexpr char kFileMagic[4] = {'H', 'M', 'C', 'L'};
+constexpr char kBlockMagic[4] = {'H', 'M', 'B', 'K'};
+
+constexpr qint64 padded(qint64 bytes)
+{
+    return (bytes + 7) & ~qint64(7);
+}
+
+bool hostIsLittleEndian()
+{
+    return QSysInfo::ByteOrder == QSysInfo::LittleEndian;
+}
+
+// 按块头描述列出各列相对块数据起点的偏移，返回块数据的总长度
+struct ColumnLayout
+{
+    qint64 x = 0, y = 0, weights = -1, timeOffsets = -1, size = 0;
+};
+
+ColumnLayout columnLayout(const BlockHeader &header)
+{
+    const qint64 count = header.count;
+    const qint64 coordinateBytes = padded(count * ((header.flags & kCompactCoordinatesFlag) ? 2 : 4));
+    ColumnLayout layout;
+    layout.y = coordinateBytes;
+    layout.size = coordinateBytes * 2;
+    if (header.flags & kHasWeightsFlag) {
+        layout.weights = layout.size;
+        layout.size += padded(count * ((header.flags & kCompactWeightsFlag) ? 1 : 4));
+    }
+    if (header.flags & kHasTimestampsFlag) {
+        layout.timeOffsets = layout.size;
+        layout.size += padded(count * 4);
+    }
+    return layout;
+}
+
+bool readFileHeader(const uchar *data, qint64 size, FileHeader *header, QString *errorString)
+{
+    if (size < qint64(sizeof(FileHeader))) {
+        if (errorString)
+            *errorString = QStringLiteral("文件过短，不是点击日志");
+        return false;
+    }
+    std::memcpy(header, data, sizeof(FileHeader));
+    if (std::memcmp(header->magic, kFileMagic, 4) != 0) {
+        if (errorString)
+            *errorString = QStringLiteral("不是点击日志文件");
+        return false;
+    }
+    if (header->version > kVersion || header->headerSize < sizeof(FileHeader) || header->headerSize % 8 != 0
+        || header->headerSize > size) {
+        if (errorString)
+            *errorString = QStringLiteral("不支持的点击日志版本 %1").arg(header->version);
+        return false;
+    }
+    return true;
+}
+
+// 依次访问 [offset, size) 中的完整数据块，遇到不完整或损坏的数据即停止，返回有效数据的结束位置
+template <typename Fn>
+qint64 forEachBlock(const uchar *data, qint64 size, qint64 offset, Fn &&fn)
+{
+    while (offset + qint64(sizeof(BlockHeader)) <= size) {
+        BlockHeader header;
+        std::memcpy(&header, data + offset, sizeof(BlockHeader));
+        if (std::memcmp(header.magic, kBlockMagic, 4) != 0)
+            break;
+        const ColumnLayout layout = columnLayout(header);
+        const qint64 columns = offset + qint64(sizeof(BlockHeader));
+        if (columns + layout.size > size)
+            break;
+        fn(header, layout, data + columns);
+        offset = columns + layout.size;
+    }
+    return offset;
+}
+
+// 块内最后一个点的时间戳
+qint64 lastTimestamp(const BlockHeader &header, const ColumnLayout &layout, const uchar *columns)
+{
+    if (header.count == 0 || layout.timeOffsets < 0)
+        return header.timeBase;
+    quint32 offset;
+    std::memcpy(&offset, columns + layout.timeOffsets + (qint64(header.count) - 1) * 4, sizeof(offset));
+    return header.timeBase + offset;
+}
+
+bool writeColumn(QIODevice &device, const void *data, qint64 bytes)
+{
+    static constexpr char kPadding[8] = {};
+    return device.write(static_cast<const char *>(data), bytes) == bytes
+           && device.write(kPadding, padded(bytes) - bytes) == padded(bytes) - bytes;
+}
+
+bool writeBlock(QIODevice &device, const HeatMapPointStore::Block &block)
+{
+    BlockHeader header = {};
+    std::memcpy(header.magic, kBlockMagic, 4);
+    header.count = static_cast<quint32>(block.count);
+    header.flags = (block.compactCoordinates ? kCompactCoordinatesFlag : 0) | (block.weights ? kHasWeightsFlag : 0)
+                   | (block.weights && block.compactWeights ? kCompactWeightsFlag : 0)
+                   | (block.timeOffsets ? kHasTimestampsFlag : 0);
+    header.timeBase = block.timeBase;
+    if (device.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header)))
+        return false;
+
+    const qint64 count = block.count;
+    const qint64 coordinateBytes = count * (block.compactCoordinates ? 2 : 4);
+    if (!writeColumn(device, block.x, coordinateBytes) || !writeColumn(device, block.y, coordinateBytes))
+        return false;
+    if (block.weights && !writeColumn(device, block.weights, count * (block.compactWeights ? 1 : 4)))
+        return false;
+    if (block.timeOffsets && !writeColumn(device, block.timeOffsets, count * 4))
+        return false;
+    return true;
+}
+
+bool writeFileHeader(QIODevice &device, const Info &info)
+{
+    FileHeader header = {};
+    std::memcpy(header.magic, kFileMagic, 4);
+    header.version = kVersion;
+    header.headerSize = sizeof(FileHeader);
+    header.flags = info.normalizedCoordinates ? kNormalizedCoordinatesFlag : 0;
+    header.baseWidth = static_cast<quint32>(qMax(0, info.baseImageSize.width()));
+    header.baseHeight = static_cast<quint32>(qMax(0, info.baseImageSize.height()));
+    return device.write(reinterpret_cast<const char *>(&header), sizeof(header)) == qint64(sizeof(header));
+}
+
+// 单个数据块的点数上限（块头为 32 位计数）
+constexpr qsizetype kMaxBlockCount = 0x7fffffff;
+
+} // namespace
+
+bool load(const QString &path, HeatMapPointStore *points, Info *info, QString *errorString)
+{
+    if (!hostIsLittleEndian()) {
+        if (errorString)
+            *errorString = QStringLiteral("点击日志仅支持小端平台");
+        return false;
+    }
+
+    // 映射由 QFile 持有，存储的各个副本通过共享所有权保证映射在渲染期间有效
+    auto file = std::make_shared<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        if (errorString)
+            *errorString = file->errorString();
+        return false;
+    }
+    const qint64 size = file->size();
+    const uchar *data = size > 0 ? file->map(0, size) : nullptr;
+    if (!data) {
+        if (errorString)
+            *errorString = size > 0 ? file->errorString() : QStringLiteral("文件为空");
+        return false;
+    }
+
+    FileHeader header;
+    if (!readFileHeader(data, size, &header, errorString))
+        return false;
+
+    const std::shared_ptr<const void> owner(file, data);
+    points->clear();
+    // 时间戳须在块内与块之间单调不减，否则时间窗口与回放的二分查找会给出错误范围。
+    // 只检查块边界（块首不早于前一块末尾、块末不早于块首），不读取整列，加载开销与点数无关；
+    // 块内顺序由写入端保证
+    qint64 previousTimestamp = std::numeric_limits<qint64>::min();
+    int blockNumber = 0;
+    int invalidBlock = 0;
+    forEachBlock(data, size, header.headerSize, [&](const BlockHeader &block, const ColumnLayout &layout, const uchar *columns) {
+        ++blockNumber;
+        if (invalidBlock != 0 || block.count == 0)
+            return;
+        const auto *offsets = layout.timeOffsets >= 0 ? reinterpret_cast<const quint32 *>(columns + layout.timeOffsets)
+                                                      : nullptr;
+        const qint64 first = offsets ? block.timeBase + offsets[0] : block.timeBase;
+        const qint64 last = lastTimestamp(block, layout, columns);
+        if (first < previousTimestamp || last < first) {
+            invalidBlock = blockNumber;
+            return;
+        }
+        previousTimestamp = last;
+
+        HeatMapPointStore::Block view;
+        view.count = block.count;
+        view.compactCoordinates = block.flags & kCompactCoordinatesFlag;
+        view.compactWeights = block.flags & kCompactWeightsFlag;
+        view.x = columns + layout.x;
+        view.y = columns + layout.y;
+        view.weights = layout.weights >= 0 ? columns + layout.weights : nullptr;
+        view.timeOffsets = offsets;
+        view.timeBase = block.timeBase;
+        points->appendExternal(view, owner);
+    });
+    if (invalidBlock != 0) {
+        points->clear();
+        if (errorString)
+            *errorString = QStringLiteral("点击日志第 %1 个数据块的时间戳早于之前的点击").arg(invalidBlock);
+        return false;
+    }
+
+    if (info) {
+        info->normalizedCoordinates = header.flags & kNormalizedCoordinatesFlag;
+        info->baseImageSize = QSize(int(header.baseWidth), int(header.baseHeight));
+    }
+    return true;
+}
+
+bool save(const QString &path, const HeatMapPointStore &points, const Info &info, QString *errorString)
+{
+    if (!hostIsLittleEndian()) {
+        if (errorString)
+            *errorString = QStringLiteral("点击日志仅支持小端平台");
+        return false;
+    }
+
+    QSaveFile file(path);
+    bool ok = file.open(QIODevice::WriteOnly) && writeFileHeader(file, info);
+    const QVector<HeatMapPointStore::Block> blocks = points.blocks();
+    for (qsizetype i = 0; ok && i < blocks.size(); ++i) {
+        Q_ASSERT(blocks.at(i).count <= kMaxBlockCount);
+        ok = writeBlock(file, blocks.at(i));
+    }
+    ok = ok && file.commit();
+    if (!ok && errorString)
+        *errorString = file.errorString();
+    return ok;
+}
+
+bool Writer::open(const QString &path, const Info &info)
+{
+    close();
+    m_info = info;
+    m_errorString.clear();
+    if (!hostIsLittleEndian())
+        return fail(QStringLiteral("点击日志仅支持小端平台"));
+
+    m_hasTimestamp = false;
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite))
+        return fail(m_file.errorString());
+
+    const qint64 size = m_file.size();
+    if (size == 0) {
+        if (!writeFileHeader(m_file, info) || !m_file.flush())
+            return fail(m_file.errorString());
+        return true;
+    }
+
+    // 已有文件：校验文件头，并截掉上次异常退出时留下的不完整块，保证新块紧接在有效数据之后
+    const uchar *data = m_file.map(0, size);
+    if (!data)
+        return fail(m_file.errorString());
+    FileHeader header;
+    QString error;
+    if (!readFileHeader(data, size, &header, &error)) {
+        m_file.unmap(const_cast<uchar *>(data));
+        return fail(error);
+    }
+    const qint64 end = forEachBlock(data, size, header.headerSize,
+                                    [&](const BlockHeader &block, const ColumnLayout &layout, const uchar *columns) {
+        if (block.count == 0)
+            return;
+        m_lastTimestamp = lastTimestamp(block, layout, columns);
+        m_hasTimestamp = true;
+    });
+    m_file.unmap(const_cast<uchar *>(data));
+
+    if (bool(header.flags & kNormalizedCoordinatesFlag) != info.normalizedCoordinates)
+        return fail(QStringLiteral("点击日志的坐标模式与记录设置不一致"));
+    if ((end < size && !m_file.resize(end)) || !m_file.seek(end))
+        return fail(m_file.errorString());
+    return true;
+}
+
+bool Writer::append(QSpan<const HeatMapPoint> points)
+{
+    if (!m_file.isOpen())
+        return fail(QStringLiteral("点击日志未打开"));
+
+    // 复用点存储的列编码：归一化坐标用 16 位紧凑编码，权重与时间戳列按需生成
+    for (qsizetype first = 0; first < points.size(); first += kMaxBlockCount) {
+        HeatMapPointStore store;
+        store.setCompact(m_info.normalizedCoordinates, false);
+        const qsizetype count = qMin(kMaxBlockCount, points.size() - first);
+        store.reserve(count);
+        for (qsizetype i = 0; i < count; ++i) {
+            HeatMapPoint point = points[first + i];
+            if (m_hasTimestamp)
+                point.timestamp = qMax(point.timestamp, m_lastTimestamp);
+            m_lastTimestamp = point.timestamp;
+            m_hasTimestamp = true;
+            store.append(point);
+        }
+        for (const HeatMapPointStore::Block &block : store.blocks()) {
+            if (!writeBlock(m_file, block))
+                return fail(m_file.errorString());
+        }
+    }
+    if (!m_file.flush())
+        return fail(m_file.errorString());
+    return true;
+}
+
+bool Writer::fail(const QString &message)
+{
+    m_errorString = message;
+    close();
+    return false;
+}
+
+} // namespace HeatMapClickLog
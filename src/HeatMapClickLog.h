@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QFile>
+#include <QSize>
+#include <QSpan>
+#include <QString>
+
+#include "HeatMapPointStore.h"
+
+// 点击日志的二进制格式（小端，版本 1）：
+//   文件头 32 字节：magic "HMCL"、quint16 版本、quint16 文件头长度、quint32 标志（bit0 归一化坐标）、
+//                   quint32 底图宽、quint32 底图高，其余保留为 0；
+//   之后是任意个数据块，每块 24 字节块头：magic "HMBK"、quint32 点数、quint32 编码标志、quint32 保留、
+//                   qint64 时间基准；随后依次为 x、y、权重（可选）、时间偏移（可选）各列，每列补齐到 8 字节。
+// 列的编码与 HeatMapPointStore 一致，加载时内存映射文件，各块直接作为点存储的外部块引用而不拷贝。
+// 时间戳在块内与块之间均单调不减（滑动窗口与回放按时间戳二分查找）。
+// 记录进程只需在文件末尾追加新块；末尾不完整或损坏的数据在加载时被忽略
+namespace HeatMapClickLog {
+
+struct Info
+{
+    bool normalizedCoordinates = false;
+    QSize baseImageSize; // 记录时的底图尺寸，未知时为空
+};
+
+// 映射 path 并把其中的全部完整数据块引用到 points（先清空），失败时返回 false 并写入 errorString；
+// 块边界处时间戳倒退的日志视为损坏而拒绝加载（块内顺序由写入端保证，加载时不逐点检查）
+bool load(const QString &path, HeatMapPointStore *points, Info *info = nullptr, QString *errorString = nullptr);
+// 把 points 完整写入 path（原子替换），每个存储块对应一个数据块
+bool save(const QString &path, const HeatMapPointStore &points, const Info &info, QString *errorString = nullptr);
+
+// 供记录进程增量追加点击：文件不存在或为空时写入文件头，否则校验文件头后在末尾追加
+class Writer
+{
+public:
+    bool open(const QString &path, const Info &info);
+    bool isOpen() const { return m_file.isOpen(); }
+    // 把一批点编码为一个数据块追加到文件并刷新，批次越大编码越紧凑；
+    // 早于已写入点击的时间戳按前一个时间戳记录，保证日志时间戳单调不减
+    bool append(QSpan<const HeatMapPoint> points);
+    void close() { m_file.close(); }
+    QString errorString() const { return m_errorString; }
+
+private:
+    bool fail(const QString &message);
+
+    QFile m_file;
+    Info m_info;
+    qint64 m_lastTimestamp = 0;
+    bool m_hasTimestamp = false;
+    QString m_errorString;
+};
+
+} // namespace HeatMapClickLog
@@ -0,0 +1,56 @@
+#include "HeatMapClickQueue.h"
+
+#include <QDateTime>
+
+HeatMapClickQueue::HeatMapClickQueue(int capacity)
+{
+    int size = 1;
+    while (size < qMax(2, capacity))
+        size <<= 1;
+    m_mask = size - 1;
+}
+
+void HeatMapClickQueue::reserve()
+{
+    if (!m_slots)
+        m_slots = std::make_unique<HeatPoint[]>(capacity());
+}
+
+bool HeatMapClickQueue::push(const QPointF &pos, qreal weight, qint64 timestamp)
+{
+    const quint64 tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > quint64(m_mask)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    reserve();
+    m_slots[tail & m_mask] = {pos, weight, timestamp < 0 ? QDateTime::currentMSecsSinceEpoch() : timestamp};
+    // 发布与下面的通知标志检查须保持顺序（与 drain() 中的复位配对），否则可能漏掉唤醒
+    m_tail.store(tail + 1, std::memory_order_seq_cst);
+
+    if (!m_notifyPending.load(std::memory_order_seq_cst) && !m_notifyPending.exchange(true) && m_notifier)
+        m_notifier();
+    return true;
+}
+
+qsizetype HeatMapClickQueue::drain(QVector<HeatPoint> &out)
+{
+    // 先复位通知标志再读取数据：此后到达的点必然再次触发通知
+    m_notifyPending.store(false, std::memory_order_seq_cst);
+
+    const quint64 head = m_head.load(std::memory_order_relaxed);
+    const quint64 tail = m_tail.load(std::memory_order_seq_cst);
+    const qsizetype count = static_cast<qsizetype>(tail - head);
+    if (count == 0)
+        return 0;
+    out.reserve(out.size() + count);
+    for (quint64 i = head; i < tail; ++i)
+        out.append(m_slots[i & m_mask]);
+    m_head.store(tail, std::memory_order_release);
+    return count;
+}
+
+bool HeatMapClickQueue::isEmpty() const
+{
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
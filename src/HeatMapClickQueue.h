@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QPointF>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "HeatMapRenderer.h"
+
+// 单生产者单消费者的无锁点击队列：采集线程调用 push()，GUI 线程批量 drain()。
+// 固定容量的环形缓冲在第一次 push()（或 reserve()）时才分配，不使用生产者接口的控件不占内存；
+// 此后 push() 不加锁、不分配内存，队列满时丢弃新点并返回 false。
+// 从空闲转为有数据时调用一次通知回调（在生产者线程执行），消费者下次 drain() 后才会再次通知，
+// 因此无论到达速率多高，每个消费节拍最多唤醒一次
+class HeatMapClickQueue
+{
+public:
+    using HeatPoint = HeatMapRenderer::HeatPoint;
+
+    // 容量向上取整为 2 的幂
+    explicit HeatMapClickQueue(int capacity = 65536);
+
+    // 仅限生产者线程（或生产者开始之前）：预先分配环形缓冲，避免第一次 push() 时分配
+    void reserve();
+    // 仅限生产者线程；timestamp 为毫秒（Unix 纪元），小于 0 时取当前时间
+    bool push(const QPointF &pos, qreal weight = 1.0, qint64 timestamp = -1);
+    // 仅限消费者线程：把当前全部点追加到 out，返回取出的个数
+    qsizetype drain(QVector<HeatPoint> &out);
+    // 生产者有新数据时的通知回调，须在生产者开始 push() 前设置
+    void setNotifier(std::function<void()> notifier) { m_notifier = std::move(notifier); }
+
+    int capacity() const { return m_mask + 1; }
+    bool isEmpty() const;
+    // 因队列已满而丢弃的点数
+    qsizetype droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    // 由生产者分配；消费者只在读到新的 m_tail 之后访问，分配先于该次发布
+    std::unique_ptr<HeatPoint[]> m_slots;
+    int m_mask = 0;
+    std::function<void()> m_notifier;
+
+    // 生产者与消费者各自独占的下标分处不同缓存行，避免伪共享
+    alignas(64) std::atomic<quint64> m_tail{0};   // 生产者写入
+    alignas(64) std::atomic<quint64> m_head{0};   // 消费者写入
+    alignas(64) std::atomic<bool> m_notifyPending{false};
+    std::atomic<qsizetype> m_dropped{0};
+};
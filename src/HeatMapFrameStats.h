@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMetaType>
+
+// 每帧的性能统计。只有定义了 HEATMAP_INSTRUMENTATION（CMake 选项 HEATMAP_ENABLE_INSTRUMENTATION）
+// 时才会采集：关闭时下面的宏展开为空，计时与计数代码不参与编译，统计始终为零
+struct HeatMapFrameStats
+{
+    // 渲染器各阶段耗时（纳秒）；增量叠加计入密度阶段
+    qint64 geometryNs = 0;
+    qint64 densityNs = 0;
+    qint64 resampleNs = 0;
+    qint64 normalizeNs = 0;
+    qint64 colorizeNs = 0;
+    // 控件绘制：背景缩放与合成耗时（纳秒）
+    qint64 backgroundScaleNs = 0;
+    qint64 composeNs = 0;
+
+    // 缓存命中与未命中次数：缩放后的背景、核印章、调色板
+    int backgroundCacheHits = 0;
+    int backgroundCacheMisses = 0;
+    int kernelCacheHits = 0;
+    int kernelCacheMisses = 0;
+    int paletteCacheHits = 0;
+    int paletteCacheMisses = 0;
+
+    qsizetype pointsStamped = 0;  // 叠加或扣除（含分箱）的点数
+    qsizetype pixelsTouched = 0;  // 重采样与着色写入的输出像素数
+    qsizetype bytesAllocated = 0; // 新分配的缓冲字节数
+    int allocations = 0;          // 新分配的缓冲个数，尺寸与参数不变时的稳态帧应为 0
+    int renderPasses = 0;         // 本帧内完成的渲染次数（后台任务与增量更新）
+
+    qint64 renderNs() const { return geometryNs + densityNs + resampleNs + normalizeNs + colorizeNs; }
+
+    // 合并另一段工作的统计（如后台任务完成后紧接的增量更新）
+    HeatMapFrameStats &operator+=(const HeatMapFrameStats &other)
+    {
+        geometryNs += other.geometryNs;
+        densityNs += other.densityNs;
+        resampleNs += other.resampleNs;
+        normalizeNs += other.normalizeNs;
+        colorizeNs += other.colorizeNs;
+        backgroundScaleNs += other.backgroundScaleNs;
+        composeNs += other.composeNs;
+        backgroundCacheHits += other.backgroundCacheHits;
+        backgroundCacheMisses += other.backgroundCacheMisses;
+        kernelCacheHits += other.kernelCacheHits;
+        kernelCacheMisses += other.kernelCacheMisses;
+        paletteCacheHits += other.paletteCacheHits;
+        paletteCacheMisses += other.paletteCacheMisses;
+        pointsStamped += other.pointsStamped;
+        pixelsTouched += other.pixelsTouched;
+        bytesAllocated += other.bytesAllocated;
+        allocations += other.allocations;
+        renderPasses += other.renderPasses;
+        return *this;
+    }
+};
+
+Q_DECLARE_METATYPE(HeatMapFrameStats)
+
+#ifdef HEATMAP_INSTRUMENTATION
+
+// 作用域计时：析构时把经过的纳秒数累加到 target
+class HeatMapStageTimer
+{
+public:
+    explicit HeatMapStageTimer(qint64 &target)
+        : m_target(target)
+    {
+        m_timer.start();
+    }
+    ~HeatMapStageTimer() { m_target += m_timer.nsecsElapsed(); }
+
+private:
+    qint64 &m_target;
+    QElapsedTimer m_timer;
+};
+
+#define HEATMAP_STATS(statement) statement
+#define HEATMAP_STAGE_TIMER_NAME(line) heatmapStageTimer##line
+#define HEATMAP_STAGE_TIMER(line, target) HeatMapStageTimer HEATMAP_STAGE_TIMER_NAME(line)(target)
+// 统计当前作用域的耗时
+#define HEATMAP_TIME_SCOPE(target) HEATMAP_STAGE_TIMER(__LINE__, target)
+
+#else
+
+#define HEATMAP_STATS(statement)
+#define HEATMAP_TIME_SCOPE(target)
+
+#endif
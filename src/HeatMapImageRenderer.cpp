@@ -0,0 +1,277 @@
+#include "HeatMapImageRenderer.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+#include <QPainter>
+#include <QPen>
+
+namespace {
+
+// 无背景且未指定尺寸时的默认画面尺寸
+constexpr int kDefaultImageSize = 1024;
+
+QColor colorValue(const QJsonValue &value, const QColor &fallback)
+{
+    const QColor color = QColor::fromString(value.toString());
+    return color.isValid() ? color : fallback;
+}
+
+} // namespace
+
+void HeatMapRenderConfig::apply(const QJsonObject &json)
+{
+    if (json.contains(QStringLiteral("scaleMode"))) {
+        const QString mode = json.value(QStringLiteral("scaleMode")).toString();
+        scaleMode = mode == QStringLiteral("fit") ? ScaleMode::FitInside : ScaleMode::CoverWidget;
+    }
+    pointRadius = qMax(1, json.value(QStringLiteral("pointRadius")).toInt(pointRadius));
+    if (json.contains(QStringLiteral("kernelShape"))) {
+        const QString shape = json.value(QStringLiteral("kernelShape")).toString();
+        falloff = shape == QStringLiteral("gaussian") ? HeatMapKernels::Falloff::Gaussian
+                                                      : HeatMapKernels::Falloff::Linear;
+    }
+    if (json.contains(QStringLiteral("densityMode"))) {
+        const QString mode = json.value(QStringLiteral("densityMode")).toString();
+        if (mode == QStringLiteral("stamped"))
+            densityMethod = HeatMapRenderParams::DensityMethod::Stamped;
+        else if (mode == QStringLiteral("binned"))
+            densityMethod = HeatMapRenderParams::DensityMethod::Binned;
+        else
+            densityMethod = HeatMapRenderParams::DensityMethod::Automatic;
+    }
+    binningThreshold = qMax(1, json.value(QStringLiteral("binningThreshold")).toInt(binningThreshold));
+    if (json.contains(QStringLiteral("timeMode"))) {
+        const QString mode = json.value(QStringLiteral("timeMode")).toString();
+        if (mode == QStringLiteral("window"))
+            timeMode = HeatMapRenderParams::TimeMode::SlidingWindow;
+        else if (mode == QStringLiteral("decay"))
+            timeMode = HeatMapRenderParams::TimeMode::ExponentialDecay;
+        else
+            timeMode = HeatMapRenderParams::TimeMode::AllTime;
+    }
+    timeWindow = qMax(1, json.value(QStringLiteral("timeWindow")).toInt(timeWindow));
+    decayHalfLife = qMax(1, json.value(QStringLiteral("decayHalfLife")).toInt(decayHalfLife));
+    densityResolution = qMax(0, json.value(QStringLiteral("densityResolution")).toInt(densityResolution));
+    keyframeBudget = qMax(0, json.value(QStringLiteral("keyframeBudget")).toInt(keyframeBudget));
+    if (json.contains(QStringLiteral("renderScale"))) {
+        const QJsonValue value = json.value(QStringLiteral("renderScale"));
+        renderScale = value.toString() == QStringLiteral("auto") ? 0.0 : qBound(0.0, value.toDouble(renderScale), 1.0);
+    }
+    adaptivePointRadius = json.value(QStringLiteral("adaptivePointRadius")).toBool(adaptivePointRadius);
+    heatmapOpacity = qBound(0.0, json.value(QStringLiteral("heatmapOpacity")).toDouble(heatmapOpacity), 1.0);
+    autoNormalize = json.value(QStringLiteral("autoNormalize")).toBool(autoNormalize);
+    if (json.contains(QStringLiteral("normalizationMode"))) {
+        const QString mode = json.value(QStringLiteral("normalizationMode")).toString();
+        normalization = mode == QStringLiteral("percentile") ? HeatMapRenderParams::Normalization::Percentile
+                                                             : HeatMapRenderParams::Normalization::Maximum;
+    }
+    normalizePercentile =
+        qBound(0.0, json.value(QStringLiteral("normalizePercentile")).toDouble(normalizePercentile), 1.0);
+    if (json.contains(QStringLiteral("intensityCurve"))) {
+        const QString curve = json.value(QStringLiteral("intensityCurve")).toString();
+        if (curve == QStringLiteral("log"))
+            intensityCurve = HeatMapRenderParams::IntensityCurve::Logarithmic;
+        else if (curve == QStringLiteral("gamma"))
+            intensityCurve = HeatMapRenderParams::IntensityCurve::Gamma;
+        else
+            intensityCurve = HeatMapRenderParams::IntensityCurve::Linear;
+    }
+    intensityGamma = qBound(0.1, json.value(QStringLiteral("intensityGamma")).toDouble(intensityGamma), 10.0);
+    normalizedCoordinates = json.value(QStringLiteral("normalizedCoordinates")).toBool(normalizedCoordinates);
+    coldColor = colorValue(json.value(QStringLiteral("coldColor")), coldColor);
+    hotColor = colorValue(json.value(QStringLiteral("hotColor")), hotColor);
+    if (json.contains(QStringLiteral("colorStops"))) {
+        colorStops.clear();
+        const QJsonArray stops = json.value(QStringLiteral("colorStops")).toArray();
+        for (qsizetype i = 0; i < stops.size(); ++i) {
+            const QJsonArray stop = stops.at(i).toArray();
+            const QColor color = colorValue(stop.at(1), QColor());
+            if (stop.size() == 2 && color.isValid())
+                colorStops.append({qBound(0.0, stop.at(0).toDouble(), 1.0), color});
+        }
+    }
+    showCrosshair = json.value(QStringLiteral("showCrosshair")).toBool(showCrosshair);
+}
+
+bool HeatMapRenderConfig::load(const QString &path, HeatMapRenderConfig *config, QString *errorString)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isObject()) {
+        if (errorString)
+            *errorString = error.errorString();
+        return false;
+    }
+    config->apply(document.object());
+    return true;
+}
+
+HeatMapImageRenderer::HeatMapImageRenderer(const HeatMapRenderConfig &config)
+    : m_config(config)
+    , m_renderer(std::make_unique<HeatMapRenderer>())
+{
+}
+
+HeatMapImageRenderer::~HeatMapImageRenderer() = default;
+
+void HeatMapImageRenderer::setThreadPool(QThreadPool *pool)
+{
+    m_renderer->setThreadPool(pool);
+}
+
+QImage HeatMapImageRenderer::render(const QImage &baseImage, const HeatMapPointStore &points, const QSize &size, qint64 now)
+{
+    QSize outputSize = size;
+    if (outputSize.isEmpty())
+        outputSize = baseImage.isNull() ? QSize(kDefaultImageSize, kDefaultImageSize) : baseImage.size();
+
+    // 每次调用的点集互不相关，密度场须整体重建；核印章与调色板跨调用复用
+    const HeatMapRenderParams params =
+        renderParams(m_config, outputSize, baseImage.size(), now < 0 ? points.lastTimestamp() : now);
+    m_renderer->invalidate(HeatMapRenderer::DensityStage);
+    m_renderer->render(params, points);
+
+    QImage image(outputSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    const QRectF baseRect = imageDisplayRect(outputSize, baseImage.size(), m_config.scaleMode);
+    const QImage scaledBase = baseImage.isNull() || baseRect.isEmpty()
+                                  ? QImage()
+                                  : scaleBaseImage(baseImage, baseRect.size().toSize(), m_config.scaleMode);
+    compose(painter, outputSize, baseRect, scaledBase, m_renderer->image(), m_config.heatmapOpacity,
+            m_config.showCrosshair);
+    painter.end();
+    return image;
+}
+
+QRectF HeatMapImageRenderer::imageDisplayRect(const QSize &size, const QSize &baseImageSize,
+                                              HeatMapRenderConfig::ScaleMode mode)
+{
+    if (size.width() <= 0 || size.height() <= 0)
+        return QRectF();
+
+    if (baseImageSize.isEmpty())
+        return QRectF(QPointF(0, 0), QSizeF(size));
+
+    QSizeF scaledSize = baseImageSize;
+    scaledSize.scale(size, mode == HeatMapRenderConfig::ScaleMode::FitInside ? Qt::KeepAspectRatio
+                                                                             : Qt::KeepAspectRatioByExpanding);
+
+    QPointF topLeft((size.width() - scaledSize.width()) / 2.0,
+                    (size.height() - scaledSize.height()) / 2.0);
+    return QRectF(topLeft, scaledSize);
+}
+
+HeatMapRenderParams HeatMapImageRenderer::renderParams(const HeatMapRenderConfig &config, const QSize &size,
+                                                       const QSize &baseImageSize, qint64 now)
+{
+    HeatMapRenderParams params;
+    params.size = size;
+    params.displayRect = imageDisplayRect(size, baseImageSize, config.scaleMode);
+    params.baseImageSize = baseImageSize;
+    params.normalizedCoordinates = config.normalizedCoordinates;
+
+    // 半径随背景缩放时按背景的显示比例放大/缩小，保证热点大小不失真
+    qreal scale = 1.0;
+    if (config.adaptivePointRadius) {
+        if (!baseImageSize.isEmpty() && !params.displayRect.isEmpty())
+            scale = qMin(params.displayRect.width() / baseImageSize.width(),
+                         params.displayRect.height() / baseImageSize.height());
+        else if (config.normalizedCoordinates)
+            scale = qMin(size.width(), size.height());
+    }
+    params.radius = qMax<qreal>(1.0, config.pointRadius * scale);
+
+    // 半径随背景缩放时，密度场只是背景图像空间中的函数：以背景分辨率（不超过上限）计算一次，
+    // 缩放窗口、切换缩放模式或裁剪只需重采样。半径固定为屏幕像素时无法与显示尺寸解耦
+    if (config.densityResolution > 0 && config.adaptivePointRadius && !baseImageSize.isEmpty()) {
+        params.canonicalSize = baseImageSize;
+        if (qMax(params.canonicalSize.width(), params.canonicalSize.height()) > config.densityResolution)
+            params.canonicalSize.scale(config.densityResolution, config.densityResolution, Qt::KeepAspectRatio);
+        params.canonicalSize = params.canonicalSize.expandedTo(QSize(1, 1));
+        const qreal canonicalScale = static_cast<qreal>(params.canonicalSize.width()) / baseImageSize.width();
+        params.radius = qMax<qreal>(1.0, config.pointRadius * canonicalScale);
+    }
+    params.falloff = config.falloff;
+    params.densityMethod = config.densityMethod;
+    params.binningThreshold = config.binningThreshold;
+    params.autoNormalize = config.autoNormalize;
+    params.normalization = config.normalization;
+    params.normalizePercentile = config.normalizePercentile;
+    params.intensityCurve = config.intensityCurve;
+    params.intensityGamma = config.intensityGamma;
+    params.timeMode = config.timeMode;
+    params.now = now;
+    params.windowStart = now - config.timeWindow;
+    params.decayHalfLife = config.decayHalfLife;
+    params.keyframeBudget = qsizetype(config.keyframeBudget) << 20;
+    params.coldColor = config.coldColor;
+    params.hotColor = config.hotColor;
+    params.colorStops = config.colorStops;
+
+    // 降低渲染分辨率：输出画面、背景区域与按输出像素计的半径同比缩小，各轴按取整后的实际比例换算，
+    // 放大回原尺寸时与背景对齐。规范分辨率的密度场不受影响，只有重采样及之后的阶段变小
+    if (config.renderScale > 0.0 && config.renderScale < 1.0 && !size.isEmpty()) {
+        params.size = QSize(qMax(1, qRound(size.width() * config.renderScale)),
+                            qMax(1, qRound(size.height() * config.renderScale)));
+        const qreal scaleX = static_cast<qreal>(params.size.width()) / size.width();
+        const qreal scaleY = static_cast<qreal>(params.size.height()) / size.height();
+        const QRectF rect = params.displayRect;
+        params.displayRect = QRectF(rect.left() * scaleX, rect.top() * scaleY, rect.width() * scaleX,
+                                    rect.height() * scaleY);
+        if (params.canonicalSize.isEmpty())
+            params.radius = qMax<qreal>(1.0, params.radius * qMin(scaleX, scaleY));
+    }
+    return params;
+}
+
+QImage HeatMapImageRenderer::scaleBaseImage(const QImage &baseImage, const QSize &targetSize,
+                                            HeatMapRenderConfig::ScaleMode mode, bool smooth)
+{
+    return baseImage.scaled(targetSize,
+                            mode == HeatMapRenderConfig::ScaleMode::FitInside ? Qt::KeepAspectRatio
+                                                                              : Qt::KeepAspectRatioByExpanding,
+                            smooth ? Qt::SmoothTransformation : Qt::FastTransformation);
+}
+
+void HeatMapImageRenderer::compose(QPainter &painter, const QSize &size, const QRectF &baseRect,
+                                   const QImage &scaledBase, const QImage &heatmap, qreal opacity, bool showCrosshair)
+{
+    painter.setRenderHint(QPainter::Antialiasing, true);
+
+    if (!scaledBase.isNull())
+        painter.drawImage(baseRect, scaledBase, QRectF(scaledBase.rect()));
+
+    if (!heatmap.isNull()) {
+        painter.setOpacity(opacity);
+        if (heatmap.size() == size) {
+            painter.drawImage(QPoint(0, 0), heatmap);
+        } else {
+            // 降低分辨率渲染或缩放窗口期间的旧帧：双线性放大到整个画面
+            painter.save();
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+            painter.drawImage(QRect(QPoint(0, 0), size), heatmap);
+            painter.restore();
+        }
+        painter.setOpacity(1.0);
+    }
+
+    if (showCrosshair)
+        drawCrosshair(painter, size);
+}
+
+void HeatMapImageRenderer::drawCrosshair(QPainter &painter, const QSize &size)
+{
+    painter.setPen(QPen(Qt::yellow, 1, Qt::DashLine));
+    painter.drawLine(size.width() / 2, 0, size.width() / 2, size.height());
+    painter.drawLine(0, size.height() / 2, size.width(), size.height() / 2);
+}
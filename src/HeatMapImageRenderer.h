@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QColor>
+#include <QBrush>
+#include <QImage>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+
+#include <memory>
+
+#include "HeatMapPointStore.h"
+#include "HeatMapRenderer.h"
+
+class QJsonObject;
+class QPainter;
+class QThreadPool;
+
+// 与 HeatMapOverlay 可视属性一一对应的渲染配置，不依赖控件，可从 config/heatmap_config.json 读取
+struct HeatMapRenderConfig
+{
+    enum class ScaleMode {
+        FitInside,  // 等比缩放背景以全部显示（信箱式）
+        CoverWidget // 等比放大并裁剪，铺满画面
+    };
+
+    ScaleMode scaleMode = ScaleMode::CoverWidget;
+    int pointRadius = 25;
+    HeatMapKernels::Falloff falloff = HeatMapKernels::Falloff::Linear;
+    HeatMapRenderParams::DensityMethod densityMethod = HeatMapRenderParams::DensityMethod::Automatic;
+    int binningThreshold = 200000;
+    HeatMapRenderParams::TimeMode timeMode = HeatMapRenderParams::TimeMode::AllTime;
+    int timeWindow = 30000;
+    int decayHalfLife = 10000;
+    int densityResolution = 2048;
+    // 回放关键帧的内存上限（MB），0 表示自动（按密度场大小，至多 8 个且不超过 32MB）
+    int keyframeBudget = 0;
+    // 热力图的渲染分辨率倍数 (0, 1]，小于 1 时在缩小的画面上重采样、归一化与着色，合成时双线性放大；
+    // 0 表示自动（控件在缩放窗口与回放时降低分辨率，离屏渲染按 1 处理）
+    qreal renderScale = 1.0;
+    bool adaptivePointRadius = true;
+    qreal heatmapOpacity = 0.65;
+    bool autoNormalize = true;
+    HeatMapRenderParams::Normalization normalization = HeatMapRenderParams::Normalization::Maximum;
+    qreal normalizePercentile = 0.99;
+    HeatMapRenderParams::IntensityCurve intensityCurve = HeatMapRenderParams::IntensityCurve::Linear;
+    qreal intensityGamma = 0.5;
+    bool normalizedCoordinates = true;
+    QColor coldColor = QColor(0, 120, 255);
+    QColor hotColor = QColor(255, 0, 0);
+    QGradientStops colorStops;
+    bool showCrosshair = false;
+
+    // 按 JSON 中出现的键覆盖对应字段，缺省的键保持原值；键名与控件属性名相同，
+    // 枚举取小写名称（如 "scaleMode": "fit" / "cover"），colorStops 为 [[位置, "#AARRGGBB"], ...]
+    void apply(const QJsonObject &json);
+    // 读取 JSON 配置文件，失败时返回 false 并写入 errorString
+    static bool load(const QString &path, HeatMapRenderConfig *config, QString *errorString = nullptr);
+};
+
+// 不依赖控件的热力图离屏渲染：背景 + 点击 + 配置 → QImage，只使用 QtGui，可在任意线程使用
+// （每个线程各自一个实例）。绘制区域、渲染参数与合成均与 HeatMapOverlay 共用同一实现，
+// 因此同尺寸下的输出与控件逐像素一致
+class HeatMapImageRenderer
+{
+public:
+    explicit HeatMapImageRenderer(const HeatMapRenderConfig &config = HeatMapRenderConfig());
+    ~HeatMapImageRenderer();
+
+    void setConfig(const HeatMapRenderConfig &config) { m_config = config; }
+    const HeatMapRenderConfig &config() const { return m_config; }
+    // 密度计算借用的线程池，为空时单线程计算；结果与线程数无关
+    void setThreadPool(QThreadPool *pool);
+
+    // 渲染一帧 ARGB32_Premultiplied 图像，size 为空时取背景尺寸（无背景时为 1024×1024）。
+    // now 为时间模式的当前时间（毫秒），小于 0 时取最后一个点击的时间戳
+    QImage render(const QImage &baseImage, const HeatMapPointStore &points, const QSize &size = QSize(), qint64 now = -1);
+
+    // 背景在 size 画面中的实际绘制区域（考虑 letterbox），无背景时为整个画面
+    static QRectF imageDisplayRect(const QSize &size, const QSize &baseImageSize, HeatMapRenderConfig::ScaleMode mode);
+    // 按配置与画面尺寸生成渲染器参数
+    static HeatMapRenderParams renderParams(const HeatMapRenderConfig &config, const QSize &size,
+                                            const QSize &baseImageSize, qint64 now);
+    // 按背景尺寸缩放背景（平滑缩放），结果绘制到 imageDisplayRect()
+    static QImage scaleBaseImage(const QImage &baseImage, const QSize &targetSize, HeatMapRenderConfig::ScaleMode mode,
+                                 bool smooth = true);
+    // 合成一帧：缩放后的背景、按透明度叠加的热力图（尺寸不符时拉伸到整个画面）、十字线
+    static void compose(QPainter &painter, const QSize &size, const QRectF &baseRect, const QImage &scaledBase,
+                        const QImage &heatmap, qreal opacity, bool showCrosshair);
+    // 画面中心的辅助十字线
+    static void drawCrosshair(QPainter &painter, const QSize &size);
+
+private:
+    HeatMapRenderConfig m_config;
+    std::unique_ptr<HeatMapRenderer> m_renderer;
+};
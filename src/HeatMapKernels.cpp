@@ -0,0 +1,645 @@
+#include "HeatMapKernels.h"
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEATMAP_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 实现按函数单独开启目标指令集，整体仍可用默认编译选项构建
+#if defined(HEATMAP_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define HEATMAP_HAVE_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define HEATMAP_TARGET_AVX2
+#else
+#define HEATMAP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace HeatMapKernels {
+
+namespace {
+
+// ---- 标量回退 ----
+
+float maxValueScalar(const float *data, qsizetype count)
+{
+    float result = 0.0f;
+    for (qsizetype i = 0; i < count; ++i)
+        result = std::max(result, data[i]);
+    return result;
+}
+
+void colorizeScalar(const float *density, QRgb *out, qsizetype count,
+                    float indexScale, const QRgb *palette, int paletteSize)
+{
+    // 先在 float 域截断到调色板上限再转整数，避免超大密度溢出。按 minps 的语义写比较
+    // （a < b ? a : b），NaN 与向量实现一样取上限，而不是把 NaN 转为整数
+    const float maxIndex = static_cast<float>(paletteSize - 1);
+    for (qsizetype i = 0; i < count; ++i) {
+        const float value = density[i] * indexScale;
+        out[i] = palette[static_cast<int>(value < maxIndex ? value : maxIndex)];
+    }
+}
+
+// 密度最小分箱下界 2^-8 对应的浮点位模式（指数与尾数高 4 位）
+constexpr qint32 kIntensityBinOrigin = (127 - 8) * kIntensityBinsPerOctave;
+
+// ---- SSE2 ----
+
+#if defined(HEATMAP_HAVE_SSE2)
+float maxValueSse2(const float *data, qsizetype count)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_max_ps(acc0, _mm_loadu_ps(data + i));
+        acc1 = _mm_max_ps(acc1, _mm_loadu_ps(data + i + 4));
+    }
+    acc0 = _mm_max_ps(acc0, acc1);
+    acc0 = _mm_max_ps(acc0, _mm_shuffle_ps(acc0, acc0, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc0 = _mm_max_ps(acc0, _mm_shuffle_ps(acc0, acc0, _MM_SHUFFLE(2, 3, 0, 1)));
+    return std::max(_mm_cvtss_f32(acc0), maxValueScalar(data + i, count - i));
+}
+
+void colorizeSse2(const float *density, QRgb *out, qsizetype count,
+                  float indexScale, const QRgb *palette, int paletteSize)
+{
+    // SSE2 没有 gather，向量化计算索引后逐个查表
+    const __m128 scale = _mm_set1_ps(indexScale);
+    const __m128 maxIndex = _mm_set1_ps(static_cast<float>(paletteSize - 1));
+    alignas(16) qint32 index[4];
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 value = _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(density + i), scale), maxIndex);
+        _mm_store_si128(reinterpret_cast<__m128i *>(index), _mm_cvttps_epi32(value));
+        out[i + 0] = palette[index[0]];
+        out[i + 1] = palette[index[1]];
+        out[i + 2] = palette[index[2]];
+        out[i + 3] = palette[index[3]];
+    }
+    colorizeScalar(density + i, out + i, count - i, indexScale, palette, paletteSize);
+}
+#endif
+
+// ---- AVX2 ----
+
+#if defined(HEATMAP_HAVE_AVX2)
+HEATMAP_TARGET_AVX2 float maxValueAvx2(const float *data, qsizetype count)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    qsizetype i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_max_ps(acc0, _mm256_loadu_ps(data + i));
+        acc1 = _mm256_max_ps(acc1, _mm256_loadu_ps(data + i + 8));
+    }
+    acc0 = _mm256_max_ps(acc0, acc1);
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    half = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return std::max(_mm_cvtss_f32(half), maxValueScalar(data + i, count - i));
+}
+
+HEATMAP_TARGET_AVX2 void colorizeAvx2(const float *density, QRgb *out, qsizetype count,
+                                      float indexScale, const QRgb *palette, int paletteSize)
+{
+    const __m256 scale = _mm256_set1_ps(indexScale);
+    const __m256 maxIndex = _mm256_set1_ps(static_cast<float>(paletteSize - 1));
+    const int *table = reinterpret_cast<const int *>(palette);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 value = _mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(density + i), scale), maxIndex);
+        const __m256i color = _mm256_i32gather_epi32(table, _mm256_cvttps_epi32(value), 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), color);
+    }
+    colorizeScalar(density + i, out + i, count - i, indexScale, palette, paletteSize);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    // 还需确认操作系统保存了 YMM 寄存器状态
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+std::atomic<int> g_activeIsa{-1};
+
+} // namespace
+
+Isa bestSupportedIsa()
+{
+#if defined(HEATMAP_HAVE_AVX2)
+    static const bool hasAvx2 = cpuHasAvx2();
+    if (hasAvx2)
+        return Isa::Avx2;
+#endif
+#if defined(HEATMAP_HAVE_SSE2)
+    return Isa::Sse2;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+Isa activeIsa()
+{
+    int isa = g_activeIsa.load(std::memory_order_relaxed);
+    if (isa < 0) {
+        isa = static_cast<int>(bestSupportedIsa());
+        g_activeIsa.store(isa, std::memory_order_relaxed);
+    }
+    return static_cast<Isa>(isa);
+}
+
+void setActiveIsa(Isa isa)
+{
+    const Isa best = bestSupportedIsa();
+    g_activeIsa.store(static_cast<int>(std::min(isa, best)), std::memory_order_relaxed);
+}
+
+float maxValue(const float *data, qsizetype count)
+{
+    switch (activeIsa()) {
+#if defined(HEATMAP_HAVE_AVX2)
+    case Isa::Avx2:
+        return maxValueAvx2(data, count);
+#endif
+#if defined(HEATMAP_HAVE_SSE2)
+    case Isa::Sse2:
+        return maxValueSse2(data, count);
+#endif
+    default:
+        return maxValueScalar(data, count);
+    }
+}
+
+void accumulateIntensityHistogram(const float *data, qsizetype count, quint32 *bins)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        if (!(data[i] > 0.0f))
+            continue;
+        quint32 bits;
+        std::memcpy(&bits, &data[i], sizeof(bits));
+        const qint32 bin = static_cast<qint32>(bits >> 19) - kIntensityBinOrigin;
+        ++bins[std::clamp(bin, 0, kIntensityBins - 1)];
+    }
+}
+
+float intensityBinLowerBound(int bin)
+{
+    const quint32 bits = static_cast<quint32>(bin + kIntensityBinOrigin) << 19;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void colorize(const float *density, QRgb *out, qsizetype count,
+              float indexScale, const QRgb *palette, int paletteSize)
+{
+    switch (activeIsa()) {
+#if defined(HEATMAP_HAVE_AVX2)
+    case Isa::Avx2:
+        colorizeAvx2(density, out, count, indexScale, palette, paletteSize);
+        return;
+#endif
+#if defined(HEATMAP_HAVE_SSE2)
+    case Isa::Sse2:
+        colorizeSse2(density, out, count, indexScale, palette, paletteSize);
+        return;
+#endif
+    default:
+        colorizeScalar(density, out, count, indexScale, palette, paletteSize);
+        return;
+    }
+}
+
+namespace {
+
+// 按衰减形状特化的核剖面，生成核时在循环外选择一次，逐像素不再判断形状
+template <Falloff Shape>
+float kernelProfile(qreal radius, qreal dist2);
+
+template <>
+float kernelProfile<Falloff::Linear>(qreal radius, qreal dist2)
+{
+    return static_cast<float>(std::max<qreal>(0.0, 1.0 - std::sqrt(dist2) / radius));
+}
+
+template <>
+float kernelProfile<Falloff::Gaussian>(qreal radius, qreal dist2)
+{
+    return static_cast<float>(std::exp(-dist2 * 2.0 / (radius * radius)));
+}
+
+// 按像素中心采样单位峰值核，核中心位于 (cx, cy)
+template <Falloff Shape>
+void fillKernel(float *out, int size, qreal cx, qreal cy, qreal radius)
+{
+    for (int y = 0; y < size; ++y) {
+        const qreal dy = y + 0.5 - cy;
+        for (int x = 0; x < size; ++x) {
+            const qreal dx = x + 0.5 - cx;
+            *out++ = kernelProfile<Shape>(radius, dx * dx + dy * dy);
+        }
+    }
+}
+
+} // namespace
+
+float kernelValue(Falloff falloff, qreal radius, qreal dist2)
+{
+    return falloff == Falloff::Gaussian ? kernelProfile<Falloff::Gaussian>(radius, dist2)
+                                        : kernelProfile<Falloff::Linear>(radius, dist2);
+}
+
+void KernelStamp::configure(qreal radius, Falloff falloff)
+{
+    if (radius == m_radius && falloff == m_falloff && !m_phases.isEmpty())
+        return;
+
+    m_radius = radius;
+    m_falloff = falloff;
+    // 高斯核在 2r 处已衰减到 exp(-8) ≈ 3e-4，低于调色板一级，之外截断
+    const qreal reach = (falloff == Falloff::Gaussian) ? radius * 2 : radius;
+    m_extent = static_cast<int>(std::ceil(reach)) + 1;
+    m_size = m_extent * 2 + 1;
+    // 半径越大亚像素偏移越不可见，减少相位数以控制缓存体积
+    m_subPixelSteps = radius < 16 ? 4 : (radius < 64 ? 2 : 1);
+    m_phases = QVector<QVector<float>>(m_subPixelSteps * m_subPixelSteps);
+    m_mass = -1.0f;
+}
+
+float KernelStamp::mass()
+{
+    if (m_mass < 0.0f) {
+        const float *kernel = phase(0, 0);
+        double sum = 0.0;
+        for (qsizetype i = 0, count = static_cast<qsizetype>(m_size) * m_size; i < count; ++i)
+            sum += kernel[i];
+        m_mass = static_cast<float>(sum);
+    }
+    return m_mass;
+}
+
+qreal KernelStamp::equivalentSigma() const
+{
+    // 高斯核 exp(-d² / (r² / 2)) 的 σ = r / 2；
+    // 线性锥形核每个轴向的方差为 0.15 r²，取同方差的高斯
+    if (m_falloff == Falloff::Gaussian)
+        return m_radius * 0.5;
+    return m_radius * std::sqrt(0.15);
+}
+
+void KernelStamp::buildAllPhases()
+{
+    for (int y = 0; y < m_subPixelSteps; ++y) {
+        for (int x = 0; x < m_subPixelSteps; ++x)
+            phase(x, y);
+    }
+}
+
+const float *KernelStamp::phase(int phaseX, int phaseY)
+{
+    // 已生成的相位只做只读访问，保证 buildAllPhases() 之后可并发调用
+    const int index = phaseY * m_subPixelSteps + phaseX;
+    const QVector<float> &cached = std::as_const(m_phases)[index];
+    if (!cached.isEmpty())
+        return cached.constData();
+
+    QVector<float> &values = m_phases[index];
+
+    // 核中心位于锚点像素内的 (phase + 0.5) / steps 处，按像素中心采样
+    values.resize(static_cast<qsizetype>(m_size) * m_size);
+    const qreal cx = m_extent + (phaseX + 0.5) / m_subPixelSteps;
+    const qreal cy = m_extent + (phaseY + 0.5) / m_subPixelSteps;
+    if (m_falloff == Falloff::Gaussian)
+        fillKernel<Falloff::Gaussian>(values.data(), m_size, cx, cy, m_radius);
+    else
+        fillKernel<Falloff::Linear>(values.data(), m_size, cx, cy, m_radius);
+    return values.constData();
+}
+
+QRect KernelStamp::stamp(float *grid, int stride, const QPointF &center, float peak, const QRect &clip)
+{
+    const int anchorX = static_cast<int>(std::floor(center.x()));
+    const int anchorY = static_cast<int>(std::floor(center.y()));
+    const int phaseX = std::min(m_subPixelSteps - 1, static_cast<int>((center.x() - anchorX) * m_subPixelSteps));
+    const int phaseY = std::min(m_subPixelSteps - 1, static_cast<int>((center.y() - anchorY) * m_subPixelSteps));
+
+    const QRect bounds = QRect(anchorX - m_extent, anchorY - m_extent, m_size, m_size) & clip;
+    if (bounds.isEmpty())
+        return QRect();
+
+    const float *kernel = phase(phaseX, phaseY);
+    const int kernelLeft = bounds.left() - (anchorX - m_extent);
+    const int kernelTop = bounds.top() - (anchorY - m_extent);
+    const int width = bounds.width();
+
+    for (int y = 0; y < bounds.height(); ++y) {
+        const float *src = kernel + static_cast<qsizetype>(kernelTop + y) * m_size + kernelLeft;
+        float *dst = grid + static_cast<qsizetype>(bounds.top() + y) * stride + bounds.left();
+        for (int x = 0; x < width; ++x)
+            dst[x] += peak * src[x];
+    }
+    return bounds;
+}
+
+namespace {
+
+struct PooledLoop;
+
+// 借用线程执行的任务：不自动删除，随调度状态跨调用复用
+class LoopHelper : public QRunnable
+{
+public:
+    explicit LoopHelper(PooledLoop *loop)
+        : m_loop(loop)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override;
+
+private:
+    PooledLoop *m_loop;
+};
+
+// 一个调用线程的调度状态。随线程结束才释放：辅助线程 release() 之后仍可能访问信号量，
+// 状态不能像单次调用的局部变量那样在返回时销毁
+struct PooledLoop
+{
+    std::atomic<int> next{0};
+    int count = 0;
+    LoopBody body = {};
+    QSemaphore finished;
+    std::vector<std::unique_ptr<LoopHelper>> helpers; // 只增不减
+    bool busy = false;
+
+    void drain()
+    {
+        for (int i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed))
+            body.invoke(body.context, i);
+    }
+};
+
+void LoopHelper::run()
+{
+    m_loop->drain();
+    m_loop->finished.release();
+}
+
+} // namespace
+
+void parallelForPooled(QThreadPool *pool, int count, LoopBody body)
+{
+    if (count <= 0)
+        return;
+
+    thread_local PooledLoop loop;
+    if (loop.busy) {
+        for (int i = 0; i < count; ++i)
+            body.invoke(body.context, i);
+        return;
+    }
+    loop.busy = true;
+    loop.next.store(0, std::memory_order_relaxed);
+    loop.count = count;
+    loop.body = body;
+
+    // 只用 tryStart 借用空闲线程，线程池被占满时不会因等待而死锁
+    const int wanted = pool ? std::min(pool->maxThreadCount(), count) - 1 : 0;
+    while (int(loop.helpers.size()) < wanted)
+        loop.helpers.push_back(std::make_unique<LoopHelper>(&loop));
+    int helpers = 0;
+    while (helpers < wanted && pool->tryStart(loop.helpers[helpers].get()))
+        ++helpers;
+
+    loop.drain();
+    loop.finished.acquire(helpers);
+    loop.busy = false;
+}
+
+void splatBilinear(float *grid, int width, int height, const QPointF &center, float mass)
+{
+    const qreal fx = center.x() - 0.5;
+    const qreal fy = center.y() - 0.5;
+    const int x0 = static_cast<int>(std::floor(fx));
+    const int y0 = static_cast<int>(std::floor(fy));
+    const float tx = static_cast<float>(fx - x0);
+    const float ty = static_cast<float>(fy - y0);
+
+    const float weights[4] = {
+        (1.0f - tx) * (1.0f - ty), tx * (1.0f - ty),
+        (1.0f - tx) * ty,          tx * ty,
+    };
+    for (int i = 0; i < 4; ++i) {
+        const int x = x0 + (i & 1);
+        const int y = y0 + (i >> 1);
+        if (x >= 0 && x < width && y >= 0 && y < height)
+            grid[static_cast<qsizetype>(y) * width + x] += mass * weights[i];
+    }
+}
+
+namespace {
+
+// 近似高斯所需的三个盒宽（均为奇数），见 P. Kovesi, "Fast Almost-Gaussian Filtering"
+void boxRadiiForGaussian(qreal sigma, int radii[3])
+{
+    const int passes = 3;
+    const qreal idealWidth = std::sqrt(12.0 * sigma * sigma / passes + 1.0);
+    int lower = static_cast<int>(std::floor(idealWidth));
+    if (lower % 2 == 0)
+        --lower;
+    lower = std::max(1, lower);
+    const int upper = lower + 2;
+    const qreal idealLowerCount = (12.0 * sigma * sigma - passes * lower * lower - 4.0 * passes * lower - 3.0 * passes)
+                                  / (-4.0 * lower - 4.0);
+    const int lowerCount = static_cast<int>(std::lround(idealLowerCount));
+    for (int i = 0; i < passes; ++i)
+        radii[i] = ((i < lowerCount ? lower : upper) - 1) / 2;
+}
+
+// 水平方向滑动和：每行维护一个窗口和，进出各一次加减
+void boxBlurRows(const float *src, float *dst, int width, int height, int radius)
+{
+    const double scale = 1.0 / (2 * radius + 1);
+    for (int y = 0; y < height; ++y) {
+        const float *in = src + static_cast<qsizetype>(y) * width;
+        float *out = dst + static_cast<qsizetype>(y) * width;
+        double sum = 0.0;
+        for (int x = 0; x <= radius && x < width; ++x)
+            sum += in[x];
+        for (int x = 0; x < width; ++x) {
+            out[x] = static_cast<float>(sum * scale);
+            if (x + radius + 1 < width)
+                sum += in[x + radius + 1];
+            if (x - radius >= 0)
+                sum -= in[x - radius];
+        }
+    }
+}
+
+// 垂直方向滑动和：按行推进、逐列维护窗口和，访问保持行连续
+void boxBlurColumns(const float *src, float *dst, int width, int height, int radius, QVector<double> &sums)
+{
+    const double scale = 1.0 / (2 * radius + 1);
+    sums.fill(0.0, width);
+    double *sum = sums.data();
+    for (int y = 0; y <= radius && y < height; ++y) {
+        const float *in = src + static_cast<qsizetype>(y) * width;
+        for (int x = 0; x < width; ++x)
+            sum[x] += in[x];
+    }
+    for (int y = 0; y < height; ++y) {
+        float *out = dst + static_cast<qsizetype>(y) * width;
+        for (int x = 0; x < width; ++x)
+            out[x] = static_cast<float>(sum[x] * scale);
+        if (y + radius + 1 < height) {
+            const float *in = src + static_cast<qsizetype>(y + radius + 1) * width;
+            for (int x = 0; x < width; ++x)
+                sum[x] += in[x];
+        }
+        if (y - radius >= 0) {
+            const float *in = src + static_cast<qsizetype>(y - radius) * width;
+            for (int x = 0; x < width; ++x)
+                sum[x] -= in[x];
+        }
+    }
+}
+
+} // namespace
+
+void gaussianBlur(float *data, int width, int height, qreal sigma, BlurScratch &scratch)
+{
+    if (width <= 0 || height <= 0 || sigma <= 0)
+        return;
+
+    int radii[3];
+    boxRadiiForGaussian(sigma, radii);
+
+    const qsizetype count = static_cast<qsizetype>(width) * height;
+    if (scratch.temp.size() < count)
+        scratch.temp.resize(count);
+    float *temp = scratch.temp.data();
+
+    // 每轮先水平（data → temp）再垂直（temp → data），结果回到 data
+    for (int radius : radii) {
+        boxBlurRows(data, temp, width, height, radius);
+        boxBlurColumns(temp, data, width, height, radius, scratch.sums);
+    }
+}
+
+void downsample2x(const float *src, int srcWidth, int srcHeight, float *dst, const QRect &dstRegion)
+{
+    const int dstWidth = (srcWidth + 1) / 2;
+    for (int y = dstRegion.top(); y <= dstRegion.bottom(); ++y) {
+        const float *row0 = src + static_cast<qsizetype>(2 * y) * srcWidth;
+        const float *row1 = src + static_cast<qsizetype>(qMin(2 * y + 1, srcHeight - 1)) * srcWidth;
+        float *out = dst + static_cast<qsizetype>(y) * dstWidth;
+        for (int x = dstRegion.left(); x <= dstRegion.right(); ++x) {
+            const int x0 = 2 * x;
+            const int x1 = qMin(x0 + 1, srcWidth - 1);
+            out[x] = 0.25f * (row0[x0] + row0[x1] + row1[x0] + row1[x1]);
+        }
+    }
+}
+
+void prepareBilinearColumns(int srcWidth, const QRectF &placement, int left, int width, BilinearColumns &columns)
+{
+    columns.left = left;
+    columns.x0.resize(width);
+    columns.x1.resize(width);
+    columns.t.resize(width);
+    if (placement.isEmpty() || srcWidth <= 0)
+        return;
+
+    const qreal scaleX = srcWidth / placement.width();
+    for (int i = 0; i < width; ++i) {
+        const qreal sx = (left + i + 0.5 - placement.left()) * scaleX;
+        if (sx < 0 || sx >= srcWidth) {
+            columns.x0[i] = -1;
+            continue;
+        }
+        const qreal fx = sx - 0.5;
+        const int x0 = static_cast<int>(std::floor(fx));
+        columns.t[i] = static_cast<float>(fx - x0);
+        columns.x0[i] = qMax(x0, 0);
+        columns.x1[i] = qMin(x0 + 1, srcWidth - 1);
+    }
+}
+
+void resampleBilinear(const float *src, int srcWidth, int srcHeight, const QRectF &placement,
+                      const BilinearColumns &columns, float *dst, int dstStride, const QRect &dstRegion)
+{
+    if (dstRegion.isEmpty())
+        return;
+    if (placement.isEmpty() || srcWidth <= 0 || srcHeight <= 0) {
+        for (int y = dstRegion.top(); y <= dstRegion.bottom(); ++y)
+            std::fill_n(dst + static_cast<qsizetype>(y) * dstStride + dstRegion.left(), dstRegion.width(), 0.0f);
+        return;
+    }
+
+    const qreal scaleY = srcHeight / placement.height();
+    const int offset = dstRegion.left() - columns.left;
+    const int *columnX0 = columns.x0.constData() + offset;
+    const int *columnX1 = columns.x1.constData() + offset;
+    const float *columnT = columns.t.constData() + offset;
+
+    for (int y = dstRegion.top(); y <= dstRegion.bottom(); ++y) {
+        float *out = dst + static_cast<qsizetype>(y) * dstStride + dstRegion.left();
+        const qreal sy = (y + 0.5 - placement.top()) * scaleY;
+        if (sy < 0 || sy >= srcHeight) {
+            std::fill_n(out, dstRegion.width(), 0.0f);
+            continue;
+        }
+        const qreal fy = sy - 0.5;
+        const int y0 = static_cast<int>(std::floor(fy));
+        const float ty = static_cast<float>(fy - y0);
+        const float *row0 = src + static_cast<qsizetype>(qMax(y0, 0)) * srcWidth;
+        const float *row1 = src + static_cast<qsizetype>(qMin(y0 + 1, srcHeight - 1)) * srcWidth;
+
+        for (int i = 0; i < dstRegion.width(); ++i) {
+            const int x0 = columnX0[i];
+            if (x0 < 0) {
+                out[i] = 0.0f;
+                continue;
+            }
+            const int x1 = columnX1[i];
+            const float tx = columnT[i];
+            const float top = row0[x0] + (row0[x1] - row0[x0]) * tx;
+            const float bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+            out[i] = top + (bottom - top) * ty;
+        }
+    }
+}
+
+} // namespace HeatMapKernels
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QRgb>
+#include <QPointF>
+#include <QRect>
+#include <QRectF>
+#include <QThreadPool>
+#include <QVector>
+
+#include <memory>
+#include <type_traits>
+
+// 热力图渲染的底层内核：核印章叠加、最大值归约与“归一化 + 查表着色”融合处理。
+// 逐像素内核提供 SSE2 / AVX2 向量化实现，运行时按 CPU 能力分派，并保留标量回退；
+// 各实现结果逐位一致，均原地读写调用方缓冲，不做额外拷贝。
+namespace HeatMapKernels {
+
+enum class Isa {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// 当前使用的指令集；首次调用时按 CPU 能力自动选择
+Isa activeIsa();
+// 强制指定指令集（用于对比测试），超出 CPU 能力时自动降级
+void setActiveIsa(Isa isa);
+// CPU 实际支持的最高指令集
+Isa bestSupportedIsa();
+
+// 返回 data[0..count) 中的最大值，count 为 0 时返回 0
+float maxValue(const float *data, qsizetype count);
+
+// out[i] = palette[min(density[i] * indexScale, paletteSize - 1)]，
+// indexScale 已包含归一化系数与调色板级数，密度须为非负值
+void colorize(const float *density, QRgb *out, qsizetype count,
+              float indexScale, const QRgb *palette, int paletteSize);
+
+// 强度直方图：正密度按 1/16 倍频程对数分箱，覆盖 2^-8 ~ 2^24，超出范围的值计入两端的分箱，
+// 0 不计入。分箱只取浮点数的指数与尾数高位，无需逐像素求对数
+constexpr int kIntensityBinsPerOctave = 16;
+constexpr int kIntensityBins = 32 * kIntensityBinsPerOctave;
+
+// 把 data[0..count) 中的正值累加到 bins[kIntensityBins]
+void accumulateIntensityHistogram(const float *data, qsizetype count, quint32 *bins);
+// 分箱 bin 覆盖的密度区间下界，bin 为 kIntensityBins 时返回最后一个分箱的上界
+float intensityBinLowerBound(int bin);
+
+// 热力点的衰减形状
+enum class Falloff {
+    Linear,   // 线性衰减，到半径处为 0（与原 QRadialGradient 外观一致）
+    Gaussian  // 高斯衰减 exp(-d² / (r² / 2))，与 scripts/generate_sample_heatmap.py 一致
+};
+
+// 单位峰值核在距中心平方距离 dist2 处的值
+float kernelValue(Falloff falloff, qreal radius, qreal dist2);
+
+// 按半径缓存的核印章：预先计算单位峰值的核，每个点只需一次带权重、裁剪、
+// 亚像素偏移的加法拷贝。半径或形状变化时才会重建，亚像素相位按需懒生成。
+class KernelStamp
+{
+public:
+    // 半径或形状与当前一致时不做任何事，否则清空所有已缓存的相位
+    void configure(qreal radius, Falloff falloff);
+
+    qreal radius() const { return m_radius; }
+    Falloff falloff() const { return m_falloff; }
+    // 核覆盖的半宽（像素），中心像素两侧各 extent 个像素
+    int extent() const { return m_extent; }
+
+    // 预先生成全部亚像素相位；并行叠加前调用，之后 stamp() 只读共享，可多线程同时使用
+    void buildAllPhases();
+
+    // 单位峰值核的总质量（积分），用于让分箱模糊结果与逐点叠加的峰值一致
+    float mass();
+    // 与核二阶矩相同的高斯标准差，供分箱模式的模糊使用
+    qreal equivalentSigma() const;
+
+    // 把 peak * 核 叠加到 grid（行宽 stride）中以 center 为中心的位置，
+    // 只写入 clip 范围内的像素，返回实际写入的区域
+    QRect stamp(float *grid, int stride, const QPointF &center, float peak, const QRect &clip);
+
+private:
+    const float *phase(int phaseX, int phaseY);
+
+    qreal m_radius = 0;
+    Falloff m_falloff = Falloff::Linear;
+    int m_extent = 0;
+    int m_size = 0;           // 核边长 2 * extent + 1
+    int m_subPixelSteps = 1;  // 每个方向的亚像素相位数
+    float m_mass = -1.0f;     // 懒计算，< 0 表示尚未计算
+    QVector<QVector<float>> m_phases;
+};
+
+// parallelFor() 传给线程池实现的循环体引用，不拥有也不复制可调用对象
+struct LoopBody
+{
+    void *context;
+    void (*invoke)(void *context, int index);
+};
+
+// parallelFor() 的线程池实现。调度状态与借用线程执行的任务对象按调用线程缓存、跨调用复用，
+// 稳态下不再分配；嵌套调用（循环体内再次并行）在调用线程串行执行
+void parallelForPooled(QThreadPool *pool, int count, LoopBody body);
+
+// 在 pool 上并行执行 body(0) ~ body(count - 1)，调用线程同样参与，返回前保证所有任务结束。
+// 任务按序号动态领取；线程池繁忙或 pool 为空时退化为在调用线程串行执行。
+// 只有一个任务或线程池只有一个线程时直接串行调用 body，不经过线程池
+template <typename Fn>
+void parallelFor(QThreadPool *pool, int count, Fn &&body)
+{
+    if (pool && count > 1 && pool->maxThreadCount() > 1) {
+        using Body = std::remove_reference_t<Fn>;
+        parallelForPooled(pool, count,
+                          {const_cast<void *>(static_cast<const void *>(std::addressof(body))),
+                           [](void *context, int index) { (*static_cast<Body *>(context))(index); }});
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+        body(i);
+}
+
+// 把 mass 按双线性权重分配到 center 周围的 4 个像素（像素中心位于 +0.5），越界部分丢弃
+void splatBilinear(float *grid, int width, int height, const QPointF &center, float mass);
+
+// gaussianBlur() 的临时缓冲：行模糊的中间结果与列方向的滑动和，按需扩容，可跨帧复用
+struct BlurScratch
+{
+    QVector<float> temp;
+    QVector<double> sums;
+};
+
+// 三次盒式模糊近似标准差为 sigma 的高斯模糊：行列分离、滑动求和实现，
+// 开销为 O(像素) 且与 sigma 无关；边界外按 0 处理
+void gaussianBlur(float *data, int width, int height, qreal sigma, BlurScratch &scratch);
+
+// 2×2 平均降采样，dst 尺寸为 ((srcWidth + 1) / 2, (srcHeight + 1) / 2)，奇数边缘重复最后一行/列；
+// 只计算 dstRegion 内的像素，便于源数据局部变化后增量更新
+void downsample2x(const float *src, int srcWidth, int srcHeight, float *dst, const QRect &dstRegion);
+
+// 双线性重采样中各目标列的取样位置与权重，同一 placement 下逐行相同。按需扩容，可跨帧复用
+struct BilinearColumns
+{
+    int left = 0;       // 第一列的目标 x 坐标
+    QVector<int> x0;    // < 0 表示该列落在 placement 之外
+    QVector<int> x1;
+    QVector<float> t;
+};
+
+// 计算目标列 [left, left + width) 的取样表
+void prepareBilinearColumns(int srcWidth, const QRectF &placement, int left, int width, BilinearColumns &columns);
+
+// 把 src 整体铺到 dst 坐标系中的 placement 区域并双线性重采样，只写入 dstRegion 内的像素；
+// placement 之外写 0，边缘像素按钳位取样。columns 须由 prepareBilinearColumns() 按相同的
+// srcWidth 与 placement 生成并覆盖 dstRegion 的全部列，只读使用，可供多个行带并行共享
+void resampleBilinear(const float *src, int srcWidth, int srcHeight, const QRectF &placement,
+                      const BilinearColumns &columns, float *dst, int dstStride, const QRect &dstRegion);
+
+} // namespace HeatMapKernels
@@ -1,12 +1,29 @@
 #include "HeatMapOverlay.h"
+#include "HeatMapClickLog.h"
 
+#include <QDateTime>
+#include <QFontMetrics>
+#include <QMouseEvent>
 #include <QPainter>
 #include <QPaintEvent>
 #include <QResizeEvent>
-#include <QtMath>
-#include <QRadialGradient>
+#include <QSemaphore>
+#include <QThread>
+#include <QWheelEvent>
+#include <algorithm>
 #include <cmath>
 
+// 一次后台渲染任务：持有渲染器及参数、点列表的快照，工作线程只访问这些数据
+struct HeatMapOverlay::RenderJob
+{
+    std::unique_ptr<HeatMapRenderer> renderer;
+    HeatMapRenderParams params;
+    HeatMapPointStore points;
+    std::atomic<bool> cancelled{false};
+    bool completed = false;
+    QSemaphore finished; // 工作线程结束后释放，用于同步等待
+};
+
 HeatMapOverlay::HeatMapOverlay(QWidget *parent)
     : QWidget(parent)
 {
@@ -14,32 +31,84 @@ HeatMapOverlay::HeatMapOverlay(QWidget *parent)
     setAttribute(Qt::WA_TransparentForMouseEvents, true);
     setAttribute(Qt::WA_OpaquePaintEvent, false);
     setAttribute(Qt::WA_NoSystemBackground, true);
+
+    // 窗口缩放停止一段时间后再把背景细化为平滑缩放
+    m_resizeSettleTimer.setSingleShot(true);
+    m_resizeSettleTimer.setInterval(150);
+    connect(&m_resizeSettleTimer, &QTimer::timeout, this, [this]() { update(); });
+
+    // 时间模式下按节拍推进当前时间，渲染器据此扣除过期点或折算衰减
+    m_timeTickTimer.setInterval(kTimeTickMs);
+    connect(&m_timeTickTimer, &QTimer::timeout, this, [this]() {
+        m_timeNow = QDateTime::currentMSecsSinceEpoch();
+        update();
+    });
+    m_timeNow = QDateTime::currentMSecsSinceEpoch();
+
+    // 回放按帧节拍推进位置
+    m_playbackTimer.setInterval(kIngestIntervalMs);
+    connect(&m_playbackTimer, &QTimer::timeout, this, &HeatMapOverlay::advancePlayback);
+
+    // 采集线程推送的点击按帧节拍合入
+    m_ingestTimer.setSingleShot(true);
+    connect(&m_ingestTimer, &QTimer::timeout, this, &HeatMapOverlay::drainClickQueue);
+    m_clickQueue.setNotifier([this]() {
+        QMetaObject::invokeMethod(this, &HeatMapOverlay::drainClickQueue, Qt::QueuedConnection);
+    });
+
+    m_renderPool.setMaxThreadCount(QThread::idealThreadCount());
+    m_renderer = std::make_unique<HeatMapRenderer>();
+    m_renderer->setThreadPool(&m_renderPool);
+    m_tileCache.setThreadPool(&m_renderPool);
+}
+
+HeatMapOverlay::~HeatMapOverlay()
+{
+    // 工作线程仍在使用渲染器与线程池，取消并等待其结束
+    if (m_activeJob) {
+        m_activeJob->cancelled = true;
+        m_activeJob->finished.acquire();
+    }
 }
 
 QVector<QPointF> HeatMapOverlay::clickPoints() const
 {
-    QVector<QPointF> result;
-    result.reserve(m_points.size());
-    for (const HeatPoint &p : m_points)
-        result.append(p.pos);
-    return result;
+    // 属性读取（如 Qt Designer、属性绑定）频繁时只在数据变化后解码一次，之后返回隐式共享的副本
+    if (m_clickPointsCache.size() != m_points.size()) {
+        m_clickPointsCache.clear();
+        m_clickPointsCache.reserve(m_points.size());
+        HeatPoint chunk[HeatMapPointStore::kDecodeChunk];
+        for (qsizetype first = 0; first < m_points.size(); first += HeatMapPointStore::kDecodeChunk) {
+            const qsizetype count = qMin(HeatMapPointStore::kDecodeChunk, m_points.size() - first);
+            m_points.decode(first, count, chunk);
+            for (qsizetype i = 0; i < count; ++i)
+                m_clickPointsCache.append(chunk[i].pos);
+        }
+    }
+    return m_clickPointsCache;
 }
 
 void HeatMapOverlay::setBaseImage(const QImage &image)
 {
     m_baseImage = image;
-    m_dirty = true;
+    invalidateScaledBase();
+    invalidate(HeatMapRenderer::GeometryStage);
     emit baseImageChanged();
     update();
 }
 
 void HeatMapOverlay::setClickPoints(const QVector<QPointF> &points)
 {
+    // 整体替换的点没有时间信息，视为此刻到达
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    stopPlayback();
     m_points.clear();
-    for (const QPointF &p : points) {
-        m_points.append({p, 1.0});
-    }
-    m_dirty = true;
+    m_clickPointsCache.clear();
+    m_spatialIndex.clear();
+    m_points.reserve(points.size());
+    for (const QPointF &p : points)
+        m_points.append({p, 1.0, now});
+    invalidate(HeatMapRenderer::DensityStage);
     emit clickPointsChanged();
     update();
 }
@@ -49,17 +118,258 @@ void HeatMapOverlay::setPointRadius(int radius)
     if (radius == m_pointRadius)
         return;
     m_pointRadius = qMax(1, radius);
-    m_dirty = true;
+    invalidate(HeatMapRenderer::GeometryStage);
     emit pointRadiusChanged();
     update();
 }
 
+void HeatMapOverlay::setKernelShape(KernelShape shape)
+{
+    if (shape == m_kernelShape)
+        return;
+    m_kernelShape = shape;
+    invalidate(HeatMapRenderer::GeometryStage);
+    emit kernelShapeChanged();
+    update();
+}
+
+void HeatMapOverlay::setDensityMode(DensityMode mode)
+{
+    if (mode == m_densityMode)
+        return;
+    m_densityMode = mode;
+    invalidate(HeatMapRenderer::DensityStage);
+    emit densityModeChanged();
+    update();
+}
+
+void HeatMapOverlay::setBinningThreshold(int count)
+{
+    count = qMax(1, count);
+    if (count == m_binningThreshold)
+        return;
+    m_binningThreshold = count;
+    invalidate(HeatMapRenderer::DensityStage);
+    emit densityModeChanged();
+    update();
+}
+
+void HeatMapOverlay::setDensityResolution(int pixels)
+{
+    pixels = qMax(0, pixels);
+    if (pixels == m_densityResolution)
+        return;
+    m_densityResolution = pixels;
+    invalidate(HeatMapRenderer::GeometryStage);
+    emit densityResolutionChanged();
+    update();
+}
+
+void HeatMapOverlay::setKeyframeBudget(int megabytes)
+{
+    megabytes = qMax(0, megabytes);
+    if (megabytes == m_keyframeBudget)
+        return;
+    m_keyframeBudget = megabytes;
+    // 关键帧在回放重新累积时按新预算生成
+    invalidate(HeatMapRenderer::DensityStage);
+    emit keyframeBudgetChanged();
+    update();
+}
+
+void HeatMapOverlay::setRenderScale(RenderScale scale)
+{
+    if (scale == m_renderScale)
+        return;
+    m_renderScale = scale;
+    emit renderScaleChanged();
+    update();
+}
+
+qreal HeatMapOverlay::effectiveRenderScale() const
+{
+    switch (m_renderScale) {
+    case FullResolution:
+        return 1.0;
+    case HalfResolution:
+        return 0.5;
+    case QuarterResolution:
+        return 0.25;
+    case AutomaticResolution:
+        break;
+    }
+    // 自动：只在缩放窗口或播放这类连续变化期间降低，停止后细化为全分辨率
+    if (!m_resizeSettleTimer.isActive() && !m_playing)
+        return 1.0;
+    const qreal radius = HeatMapRenderer::displayRadius(renderParams(1.0));
+    for (qreal scale : {0.25, 0.5}) {
+        if (radius * scale >= kMinScaledRadius)
+            return scale;
+    }
+    return 1.0;
+}
+
+void HeatMapOverlay::applyRenderScale()
+{
+    // 输出尺寸变化由几何阶段处理：规范分辨率的密度场只需重采样，否则按新尺寸重新叠加
+    const qreal scale = effectiveRenderScale();
+    if (scale == m_appliedRenderScale)
+        return;
+    m_appliedRenderScale = scale;
+    m_pendingStages |= HeatMapRenderer::GeometryStage;
+}
+
+void HeatMapOverlay::setTimeMode(TimeMode mode)
+{
+    if (mode == m_timeMode)
+        return;
+    m_timeMode = mode;
+    updateTimeTicking();
+    invalidate(HeatMapRenderer::DensityStage);
+    emit timeModeChanged();
+    update();
+}
+
+void HeatMapOverlay::setTimeWindow(int milliseconds)
+{
+    milliseconds = qMax(1, milliseconds);
+    if (milliseconds == m_timeWindow)
+        return;
+    m_timeWindow = milliseconds;
+    if (m_timeMode == SlidingWindow)
+        invalidate(HeatMapRenderer::DensityStage);
+    emit timeModeChanged();
+    update();
+}
+
+void HeatMapOverlay::setDecayHalfLife(int milliseconds)
+{
+    milliseconds = qMax(1, milliseconds);
+    if (milliseconds == m_decayHalfLife)
+        return;
+    m_decayHalfLife = milliseconds;
+    if (m_timeMode == ExponentialDecay)
+        invalidate(HeatMapRenderer::DensityStage);
+    emit timeModeChanged();
+    update();
+}
+
+void HeatMapOverlay::updateTimeTicking()
+{
+    m_timeNow = QDateTime::currentMSecsSinceEpoch();
+    if (m_timeMode == AllTime)
+        m_timeTickTimer.stop();
+    else if (!m_timeTickTimer.isActive())
+        m_timeTickTimer.start();
+}
+
+void HeatMapOverlay::enterPlayback()
+{
+    if (m_playbackActive)
+        return;
+    m_playbackActive = true;
+    m_playbackPosition = playbackStartTime();
+    // 重新累积一次，累计模式下同时生成回放关键帧
+    invalidate(HeatMapRenderer::DensityStage);
+}
+
+void HeatMapOverlay::play()
+{
+    if (m_points.isEmpty() || m_playing)
+        return;
+    enterPlayback();
+    if (m_playbackPosition >= playbackEndTime())
+        m_playbackPosition = playbackStartTime();
+    m_playing = true;
+    m_playbackOrigin = m_playbackPosition;
+    m_playbackClock.start();
+    m_playbackTimer.start();
+    emit playbackStateChanged();
+    emit playbackPositionChanged(m_playbackPosition);
+    update();
+}
+
+void HeatMapOverlay::pause()
+{
+    if (!m_playing)
+        return;
+    m_playing = false;
+    m_playbackTimer.stop();
+    emit playbackStateChanged();
+    // 自动渲染分辨率在暂停后细化
+    update();
+}
+
+void HeatMapOverlay::seek(qint64 position)
+{
+    enterPlayback();
+    position = qBound(playbackStartTime(), position, qMax(playbackStartTime(), playbackEndTime()));
+    m_playbackOrigin = position;
+    m_playbackClock.start();
+    if (position != m_playbackPosition) {
+        m_playbackPosition = position;
+        emit playbackPositionChanged(m_playbackPosition);
+    }
+    update();
+}
+
+void HeatMapOverlay::setPlaybackSpeed(qreal speed)
+{
+    speed = qBound<qreal>(0.01, speed, 10000.0);
+    if (qFuzzyCompare(speed, m_playbackSpeed))
+        return;
+    // 以当前位置为新的起点，改变速度时位置不跳变
+    m_playbackSpeed = speed;
+    m_playbackOrigin = m_playbackPosition;
+    m_playbackClock.start();
+    emit playbackSpeedChanged();
+}
+
+void HeatMapOverlay::stopPlayback()
+{
+    if (!m_playbackActive)
+        return;
+    const bool wasPlaying = m_playing;
+    m_playing = false;
+    m_playbackActive = false;
+    m_playbackTimer.stop();
+    // 回放位置之后的点由渲染器增量补齐，关键帧随之释放
+    if (wasPlaying)
+        emit playbackStateChanged();
+    update();
+}
+
+void HeatMapOverlay::advancePlayback()
+{
+    const qint64 end = playbackEndTime();
+    const qint64 position = qMin(end, m_playbackOrigin + qint64(m_playbackClock.elapsed() * m_playbackSpeed));
+    if (position != m_playbackPosition) {
+        m_playbackPosition = position;
+        emit playbackPositionChanged(m_playbackPosition);
+        update();
+    }
+    if (position >= end)
+        pause();
+}
+
+void HeatMapOverlay::setWorkerThreadCount(int count)
+{
+    count = qMax(0, count);
+    if (count == m_workerThreadCount)
+        return;
+    m_workerThreadCount = count;
+    // 并行与串行结果逐位一致，线程数变化无需重新渲染
+    m_renderPool.setMaxThreadCount(count > 0 ? count : QThread::idealThreadCount());
+    emit workerThreadCountChanged();
+}
+
 void HeatMapOverlay::setScaleMode(ScaleMode mode)
 {
     if (mode == m_scaleMode)
         return;
     m_scaleMode = mode;
-    m_dirty = true;
+    invalidateScaledBase();
+    invalidate(HeatMapRenderer::GeometryStage);
     emit scaleModeChanged();
     update();
 }
@@ -69,15 +379,15 @@ void HeatMapOverlay::setAdaptivePointRadius(bool on)
     if (on == m_adaptivePointRadius)
         return;
     m_adaptivePointRadius = on;
-    m_dirty = true;
+    invalidate(HeatMapRenderer::GeometryStage);
     emit adaptivePointRadiusChanged();
     update();
 }
 
 void HeatMapOverlay::setHeatmapOpacity(qreal value)
 {
+    // 透明度在绘制时通过 QPainter 应用，只需重新合成
     m_heatmapOpacity = qBound<qreal>(0.0, value, 1.0);
-    m_dirty = true;
     emit heatmapOpacityChanged();
     update();
 }
@@ -87,37 +397,141 @@ void HeatMapOverlay::setAutoNormalize(bool on)
     if (on == m_autoNormalize)
         return;
     m_autoNormalize = on;
-    m_dirty = true;
+    invalidate(HeatMapRenderer::NormalizeStage);
     emit autoNormalizeChanged();
     update();
 }
 
+void HeatMapOverlay::setNormalizationMode(NormalizationMode mode)
+{
+    if (mode == m_normalizationMode)
+        return;
+    m_normalizationMode = mode;
+    // 分位数所需的直方图由渲染器在归一化阶段按需补建，密度无需重算
+    invalidate(HeatMapRenderer::NormalizeStage);
+    emit normalizationChanged();
+    update();
+}
+
+void HeatMapOverlay::setNormalizePercentile(qreal percentile)
+{
+    percentile = qBound<qreal>(0.0, percentile, 1.0);
+    if (qFuzzyCompare(percentile, m_normalizePercentile))
+        return;
+    m_normalizePercentile = percentile;
+    if (m_normalizationMode == PercentileNormalization)
+        invalidate(HeatMapRenderer::NormalizeStage);
+    emit normalizationChanged();
+    update();
+}
+
+void HeatMapOverlay::setIntensityCurve(IntensityCurve curve)
+{
+    if (curve == m_intensityCurve)
+        return;
+    m_intensityCurve = curve;
+    // 曲线烘焙在调色板中，只需重新查表着色
+    invalidate(HeatMapRenderer::ColorizeStage);
+    emit intensityCurveChanged();
+    update();
+}
+
+void HeatMapOverlay::setIntensityGamma(qreal gamma)
+{
+    gamma = qBound<qreal>(0.1, gamma, 10.0);
+    if (qFuzzyCompare(gamma, m_intensityGamma))
+        return;
+    m_intensityGamma = gamma;
+    if (m_intensityCurve == GammaCurve)
+        invalidate(HeatMapRenderer::ColorizeStage);
+    emit intensityCurveChanged();
+    update();
+}
+
 void HeatMapOverlay::setNormalizedCoordinates(bool on)
 {
     if (on == m_normalizedCoords)
         return;
     m_normalizedCoords = on;
-    m_dirty = true;
+    // 16 位量化只适用于归一化坐标
+    m_points.setCompact(m_compactPointStorage && m_normalizedCoords, m_compactPointStorage);
+    m_clickPointsCache.clear();
+    m_spatialIndex.clear();
+    invalidate(HeatMapRenderer::GeometryStage);
     emit normalizedCoordinatesChanged();
     update();
 }
 
+void HeatMapOverlay::setCompactPointStorage(bool on)
+{
+    if (on == m_compactPointStorage)
+        return;
+    m_compactPointStorage = on;
+    // 重新编码后坐标与权重按量化值计算，需要重新累积
+    m_points.setCompact(m_compactPointStorage && m_normalizedCoords, m_compactPointStorage);
+    m_clickPointsCache.clear();
+    m_spatialIndex.clear();
+    invalidate(HeatMapRenderer::DensityStage);
+    emit compactPointStorageChanged();
+    update();
+}
+
 void HeatMapOverlay::setColdColor(const QColor &color)
 {
+    if (color == m_coldColor)
+        return;
     m_coldColor = color;
-    m_dirty = true;
+    invalidate(HeatMapRenderer::ColorizeStage);
     emit colorRampChanged();
     update();
 }
 
 void HeatMapOverlay::setHotColor(const QColor &color)
 {
+    if (color == m_hotColor)
+        return;
     m_hotColor = color;
-    m_dirty = true;
+    invalidate(HeatMapRenderer::ColorizeStage);
+    emit colorRampChanged();
+    update();
+}
+
+void HeatMapOverlay::setColorStops(const QGradientStops &stops)
+{
+    if (stops == m_colorStops)
+        return;
+    m_colorStops = stops;
+    std::sort(m_colorStops.begin(), m_colorStops.end(), [](const QGradientStop &a, const QGradientStop &b) {
+        return a.first < b.first;
+    });
+    invalidate(HeatMapRenderer::ColorizeStage);
     emit colorRampChanged();
     update();
 }
 
+QGradientStops HeatMapOverlay::eyeTrackingColorStops()
+{
+    return {
+        {0.00, QColor(0, 0, 255, 0)},
+        {0.25, QColor(0, 0, 255, 160)},
+        {0.50, QColor(0, 255, 0, 200)},
+        {0.75, QColor(255, 255, 0, 230)},
+        {1.00, QColor(255, 0, 0, 255)},
+    };
+}
+
+void HeatMapOverlay::invalidate(uint stages)
+{
+    // 渲染器可能正被工作线程使用，失效先累积，下次调度时再交给渲染器；
+    // 进行中的任务结果已过时，请求其尽快结束
+    m_pendingStages |= stages;
+    if (m_activeJob)
+        m_activeJob->cancelled = true;
+    // 点数据被替换或密度场本身失效时，瓦片与点索引一并作废；其余变化由瓦片缓存按参数自行判断
+    if (stages & (HeatMapRenderer::GeometryStage | HeatMapRenderer::DensityStage))
+        m_tileCache.clear();
+}
+
 void HeatMapOverlay::setShowCrosshair(bool on)
 {
     if (on == m_showCrosshair)
@@ -127,208 +541,635 @@ void HeatMapOverlay::setShowCrosshair(bool on)
     update();
 }
 
-void HeatMapOverlay::addClick(const QPointF &pos, qreal weight)
+void HeatMapOverlay::setShowStatsHud(bool on)
+{
+    if (on == m_showStatsHud)
+        return;
+    m_showStatsHud = on;
+    emit showStatsHudChanged();
+    update();
+}
+
+void HeatMapOverlay::setZoom(qreal zoom)
+{
+    if (m_zoom > 0.0)
+        zoomAt(QPointF(width() / 2.0, height() / 2.0), zoom / m_zoom);
+}
+
+void HeatMapOverlay::setPanOffset(const QPointF &offset)
+{
+    setViewport(m_zoom, offset);
+}
+
+void HeatMapOverlay::setInteractiveViewport(bool on)
+{
+    if (on == m_interactiveViewport)
+        return;
+    m_interactiveViewport = on;
+    m_panning = false;
+    setAttribute(Qt::WA_TransparentForMouseEvents, !on);
+    emit interactiveViewportChanged();
+}
+
+void HeatMapOverlay::resetViewport()
+{
+    setViewport(1.0, QPointF());
+}
+
+void HeatMapOverlay::zoomAt(const QPointF &widgetPos, qreal factor)
+{
+    const QPointF content = mapToContent(widgetPos);
+    const qreal zoom = qBound(1.0, m_zoom * factor, kMaxZoom);
+    setViewport(zoom, content - widgetPos / zoom);
+}
+
+QPointF HeatMapOverlay::mapToContent(const QPointF &widgetPos) const
+{
+    return m_panOffset + widgetPos / m_zoom;
+}
+
+void HeatMapOverlay::setViewport(qreal zoom, const QPointF &panOffset)
+{
+    // 视口始终落在画面内：平移范围为 [0, 尺寸 × (1 - 1/zoom)]
+    zoom = qBound(1.0, zoom, kMaxZoom);
+    const QPointF pan(qBound(0.0, panOffset.x(), width() * (1.0 - 1.0 / zoom)),
+                      qBound(0.0, panOffset.y(), height() * (1.0 - 1.0 / zoom)));
+    if (qFuzzyCompare(zoom, m_zoom) && pan == m_panOffset)
+        return;
+    m_zoom = zoom;
+    m_panOffset = pan;
+    emit viewportChanged();
+    update();
+}
+
+void HeatMapOverlay::wheelEvent(QWheelEvent *event)
+{
+    if (!m_interactiveViewport) {
+        QWidget::wheelEvent(event);
+        return;
+    }
+    // 每格滚轮（120）缩放 1.25 倍，光标下的内容保持不动
+    zoomAt(event->position(), std::pow(1.25, event->angleDelta().y() / 120.0));
+    event->accept();
+}
+
+void HeatMapOverlay::mousePressEvent(QMouseEvent *event)
+{
+    // 只占用中键与右键用于平移，左键继续传给下层控件（如录入点击）
+    if (m_interactiveViewport && (event->button() == Qt::MiddleButton || event->button() == Qt::RightButton)) {
+        m_panning = true;
+        m_panAnchor = event->position();
+        event->accept();
+        return;
+    }
+    QWidget::mousePressEvent(event);
+}
+
+void HeatMapOverlay::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!m_panning) {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+    setPanOffset(m_panOffset - (event->position() - m_panAnchor) / m_zoom);
+    m_panAnchor = event->position();
+    event->accept();
+}
+
+void HeatMapOverlay::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!m_panning) {
+        QWidget::mouseReleaseEvent(event);
+        return;
+    }
+    if (!(event->buttons() & (Qt::MiddleButton | Qt::RightButton)))
+        m_panning = false;
+    event->accept();
+}
+
+void HeatMapOverlay::appendPoint(const HeatPoint &point)
+{
+    // 滑动窗口按时间戳二分查找过期点，时间戳须单调不减
+    qint64 timestamp = point.timestamp < 0 ? QDateTime::currentMSecsSinceEpoch() : point.timestamp;
+    if (!m_points.isEmpty())
+        timestamp = qMax(timestamp, m_points.lastTimestamp());
+    m_points.append({point.pos, qMax<qreal>(0.01, point.weight), timestamp});
+}
+
+void HeatMapOverlay::addClick(const QPointF &pos, qreal weight, qint64 timestamp)
+{
+    // 无需整图重建：下一次绘制时仅把新增点叠加到累积缓冲；
+    // 进行中的后台任务不受影响，结束后再增量叠加新增点
+    appendPoint({pos, weight, timestamp});
+    update();
+}
+
+void HeatMapOverlay::addClicks(QSpan<const HeatPoint> clicks)
 {
-    m_points.append({pos, qMax<qreal>(0.01, weight)});
-    m_dirty = true;
+    if (clicks.empty())
+        return;
+    for (const HeatPoint &click : clicks)
+        appendPoint(click);
     update();
 }
 
+void HeatMapOverlay::drainClickQueue()
+{
+    // 距上次合入不足一帧时推迟，期间到达的点击在下一帧一并合入
+    if (m_ingestClock.isValid() && m_ingestClock.elapsed() < kIngestIntervalMs) {
+        if (!m_ingestTimer.isActive())
+            m_ingestTimer.start(kIngestIntervalMs - static_cast<int>(m_ingestClock.elapsed()));
+        return;
+    }
+    m_ingestClock.start();
+
+    m_clickQueue.drain(m_ingestBuffer);
+    addClicks(m_ingestBuffer);
+    m_ingestBuffer.clear();
+}
+
 void HeatMapOverlay::clearClicks()
 {
+    stopPlayback();
     m_points.clear();
-    m_dirty = true;
+    m_clickPointsCache.clear();
+    m_spatialIndex.clear();
+    invalidate(HeatMapRenderer::DensityStage);
+    update();
+}
+
+void HeatMapOverlay::reserveClicks(qsizetype count)
+{
+    m_points.reserve(count);
+}
+
+bool HeatMapOverlay::loadClicks(const QString &path, QString *errorString)
+{
+    HeatMapPointStore points;
+    HeatMapClickLog::Info info;
+    if (!HeatMapClickLog::load(path, &points, &info, errorString))
+        return false;
+
+    // 回放位置与关键帧属于原来的点集
+    stopPlayback();
+    setNormalizedCoordinates(info.normalizedCoordinates);
+    // 映射中的块保持文件里的编码，只有之后追加的点按当前设置编码
+    points.setCompact(m_compactPointStorage && m_normalizedCoords, m_compactPointStorage);
+    m_points = points;
+    m_clickPointsCache.clear();
+    m_spatialIndex.clear();
+    invalidate(HeatMapRenderer::DensityStage);
+    emit clickPointsChanged();
     update();
+    return true;
+}
+
+bool HeatMapOverlay::saveClicks(const QString &path, QString *errorString) const
+{
+    HeatMapClickLog::Info info;
+    info.normalizedCoordinates = m_normalizedCoords;
+    info.baseImageSize = m_baseImage.size();
+    return HeatMapClickLog::save(path, m_points, info, errorString);
 }
 
 void HeatMapOverlay::paintEvent(QPaintEvent *event)
 {
     Q_UNUSED(event);
 
+    // 廉价的增量更新直接完成，其余工作交给后台任务
+    scheduleRender();
+
+    // 背景按控件大小自适应缩放；有后台任务或上次任务被取消时显示上一帧，尺寸不符（如缩放中）时拉伸显示。
+    // 合成与离屏渲染共用同一实现，保证批量导出的图片与控件一致。放大后背景由瓦片缓存按级别缩放
+    const QRectF targetRect = imageDisplayRect();
+    if (!m_baseImage.isNull() && !targetRect.isEmpty() && m_zoom <= 1.0)
+        ensureScaledBase(targetRect.size().toSize());
+    const QImage &frame = m_frame.isNull() && m_renderer ? m_renderer->image() : m_frame;
+
     QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing, true);
+    {
+        HEATMAP_TIME_SCOPE(m_pendingStats.composeNs);
+        if (m_zoom > 1.0)
+            paintViewport(painter, targetRect, frame);
+        else
+            HeatMapImageRenderer::compose(painter, size(), targetRect, m_scaledBase, frame, m_heatmapOpacity,
+                                          m_showCrosshair);
+    }
 
-    // 绘制背景图片，可根据控件大小自适应缩放
-    QRectF targetRect = imageDisplayRect();
-    if (!m_baseImage.isNull() && !targetRect.isEmpty()) {
-        QSize targetSize = targetRect.size().toSize();
-        Qt::AspectRatioMode mode = (m_scaleMode == FitInside) ? Qt::KeepAspectRatio : Qt::KeepAspectRatioByExpanding;
-        QImage scaled = m_baseImage.scaled(targetSize, mode, Qt::SmoothTransformation);
-        painter.drawImage(targetRect, scaled, scaled.rect());
+#ifdef HEATMAP_INSTRUMENTATION
+    m_frameStats = m_pendingStats;
+    m_pendingStats = HeatMapFrameStats();
+    if (m_showStatsHud) {
+        const HeatMapFrameStats &stats = m_frameStats;
+        const QString text =
+            QStringLiteral("渲染 %1 ms（几何 %2 / 密度 %3 / 重采样 %4 / 归一化 %5 / 着色 %6）\n"
+                           "背景缩放 %7 ms  合成 %8 ms  渲染次数 %9\n"
+                           "缓存命中/未命中：背景 %10/%11  核 %12/%13  调色板 %14/%15\n"
+                           "叠加点数 %16  写入像素 %17  新分配 %18 次 / %19 KB")
+                .arg(stats.renderNs() / 1e6, 0, 'f', 2)
+                .arg(stats.geometryNs / 1e6, 0, 'f', 2)
+                .arg(stats.densityNs / 1e6, 0, 'f', 2)
+                .arg(stats.resampleNs / 1e6, 0, 'f', 2)
+                .arg(stats.normalizeNs / 1e6, 0, 'f', 2)
+                .arg(stats.colorizeNs / 1e6, 0, 'f', 2)
+                .arg(stats.backgroundScaleNs / 1e6, 0, 'f', 2)
+                .arg(stats.composeNs / 1e6, 0, 'f', 2)
+                .arg(stats.renderPasses)
+                .arg(stats.backgroundCacheHits)
+                .arg(stats.backgroundCacheMisses)
+                .arg(stats.kernelCacheHits)
+                .arg(stats.kernelCacheMisses)
+                .arg(stats.paletteCacheHits)
+                .arg(stats.paletteCacheMisses)
+                .arg(stats.pointsStamped)
+                .arg(stats.pixelsTouched)
+                .arg(stats.allocations)
+                .arg(stats.bytesAllocated / 1024);
+        const QRect textRect = painter.fontMetrics().boundingRect(rect().adjusted(8, 8, -8, -8), Qt::AlignLeft, text);
+        painter.fillRect(textRect.adjusted(-4, -4, 4, 4), QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        painter.drawText(textRect, Qt::AlignLeft, text);
     }
+    emit frameStatsUpdated(m_frameStats);
+#endif
+}
 
-    // 生成热力图缓存
-    if (m_dirty)
-        regenerateCache();
+void HeatMapOverlay::paintViewport(QPainter &painter, const QRectF &targetRect, const QImage &frame)
+{
+    const HeatMapTileCache::Viewport viewport = this->viewport();
+    painter.setRenderHint(QPainter::Antialiasing, true);
 
-    if (!m_cachedHeatmap.isNull()) {
-        painter.setOpacity(m_heatmapOpacity);
-        painter.drawImage(QPoint(0, 0), m_cachedHeatmap);
-        painter.setOpacity(1.0);
-    }
+    // 放大后背景按缩放级别从原图分块缩放并缓存，平移与同级缩放只绘制已有瓦片，保持清晰
+    m_tileCache.setBaseImage(m_baseImage, targetRect);
 
-    if (m_showCrosshair) {
-        painter.setPen(QPen(Qt::yellow, 1, Qt::DashLine));
-        painter.drawLine(width() / 2, 0, width() / 2, height());
-        painter.drawLine(0, height() / 2, width(), height() / 2);
+    // 瓦片沿用整幅渲染的归一化、调色板与衰减基准；渲染器在后台任务中时沿用上次的设置
+    if (m_renderer) {
+        HeatMapTileCache::Coloring coloring;
+        coloring.normalizeScale = m_renderer->normalizeScale();
+        coloring.palette = m_renderer->palette();
+        coloring.decayOrigin = m_renderer->decayOrigin();
+        m_tileCache.setColoring(coloring);
     }
+    m_tileCache.setParams(renderParams(1.0), m_adaptivePointRadius);
+    const bool complete = m_tileCache.update(size(), viewport, m_points, spatialIndex(), kTileBudgetMs);
+    m_tileCache.draw(painter, size(), viewport, frame, m_heatmapOpacity);
+
+    if (m_showCrosshair)
+        HeatMapImageRenderer::drawCrosshair(painter, size());
+    // 本帧预算内未完成的瓦片在下一帧继续计算
+    if (!complete)
+        update();
 }
 
 void HeatMapOverlay::resizeEvent(QResizeEvent *event)
 {
     QWidget::resizeEvent(event);
-    // 大小变更后需要重算热力图
-    m_dirty = true;
+    setViewport(m_zoom, m_panOffset);
+    // 大小变更后需要更新热力图（规范分辨率下只需重采样），背景先快速缩放，停止缩放后再细化
+    invalidate(HeatMapRenderer::GeometryStage);
+    invalidateScaledBase();
+    m_resizeSettleTimer.start();
 }
 
-QRectF HeatMapOverlay::displayRect() const
+void HeatMapOverlay::invalidateScaledBase()
 {
-    return imageDisplayRect();
+    m_scaledBase = QImage();
+    m_scaledBaseSize = QSize();
 }
 
-QRectF HeatMapOverlay::imageDisplayRect() const
+void HeatMapOverlay::ensureScaledBase(const QSize &targetSize)
 {
-    if (width() <= 0 || height() <= 0)
-        return QRectF();
+    // 缩放过程中使用快速变换，避免每一帧都对大尺寸截图做平滑缩放
+    const bool smooth = !m_resizeSettleTimer.isActive();
+    const bool cacheValid = !m_scaledBase.isNull()
+                            && m_scaledBaseSize == targetSize
+                            && m_scaledBaseMode == m_scaleMode
+                            && (m_scaledBaseSmooth || !smooth);
+    HEATMAP_STATS(++(cacheValid ? m_pendingStats.backgroundCacheHits : m_pendingStats.backgroundCacheMisses));
+    if (cacheValid)
+        return;
 
-    if (m_baseImage.isNull())
-        return QRectF(QPointF(0, 0), QSizeF(width(), height()));
+    HEATMAP_TIME_SCOPE(m_pendingStats.backgroundScaleNs);
+    m_scaledBase = HeatMapImageRenderer::scaleBaseImage(m_baseImage, targetSize, renderConfig().scaleMode, smooth);
+    m_scaledBaseSize = targetSize;
+    m_scaledBaseMode = m_scaleMode;
+    m_scaledBaseSmooth = smooth;
+}
 
-    QSizeF scaledSize = m_baseImage.size();
-    Qt::AspectRatioMode mode = (m_scaleMode == FitInside) ? Qt::KeepAspectRatio : Qt::KeepAspectRatioByExpanding;
-    scaledSize.scale(size(), mode);
+void HeatMapOverlay::collectRenderStats(const HeatMapRenderer &renderer)
+{
+    HEATMAP_STATS(m_pendingStats += renderer.stats());
+    Q_UNUSED(renderer);
+}
 
-    QPointF topLeft((width() - scaledSize.width()) / 2.0,
-                    (height() - scaledSize.height()) / 2.0);
-    return QRectF(topLeft, scaledSize);
+const HeatMapSpatialIndex &HeatMapOverlay::spatialIndex() const
+{
+    // 索引按点坐标划分：归一化坐标为单位正方形，有背景时为背景的像素范围；
+    // 无背景时像素坐标没有固定范围，按点的包围盒划分，控件尺寸变化不触发重建
+    if (m_normalizedCoords)
+        m_spatialIndex.setBounds(QRectF(0, 0, 1, 1));
+    else if (m_baseImage.isNull())
+        m_spatialIndex.setAutomaticBounds();
+    else
+        m_spatialIndex.setBounds(QRectF(QPointF(0, 0), QSizeF(m_baseImage.size())));
+    m_spatialIndex.update(m_points);
+    return m_spatialIndex;
 }
 
-QPointF HeatMapOverlay::mapToDisplay(const QPointF &pos) const
+qsizetype HeatMapOverlay::queryWindowBegin(const HeatMapRenderParams &params) const
 {
-    QRectF targetRect = imageDisplayRect();
+    return params.timeMode == HeatMapRenderParams::TimeMode::SlidingWindow
+               ? m_points.lowerBoundTimestamp(params.windowStart)
+               : 0;
+}
 
-    if (m_normalizedCoords) {
-        if (targetRect.isEmpty())
-            return QPointF(pos.x() * width(), pos.y() * height());
+float HeatMapOverlay::densityAt(const QPointF &pos) const
+{
+    // 在全分辨率输出像素中按核精确求和（分箱模式显示的是其模糊近似）；候选范围为核覆盖的半宽
+    const HeatMapRenderParams params = renderParams(1.0);
+    const HeatMapSpatialIndex &index = spatialIndex();
+    const qreal radius = HeatMapRenderer::displayRadius(params);
+    const qreal reach = params.falloff == HeatMapKernels::Falloff::Gaussian ? radius * 2 : radius;
+    const QPointF center = HeatMapRenderer::mapToDisplay(params, pos);
+    const QRectF query(HeatMapRenderer::mapFromDisplay(params, center - QPointF(reach, reach)),
+                       HeatMapRenderer::mapFromDisplay(params, center + QPointF(reach, reach)));
 
-        return QPointF(targetRect.left() + pos.x() * targetRect.width(),
-                       targetRect.top() + pos.y() * targetRect.height());
-    }
+    QVector<quint32> candidates;
+    index.candidates(query, queryWindowBegin(params), HeatMapRenderer::pointEnd(params, m_points), candidates);
+    const HeatMapPointMapping mapping = HeatMapRenderer::displayMapping(params);
+    float density = 0.0f;
+    HeatMapRenderer::withPeakFunction(params, params.now, [&](auto peakOf) {
+        for (quint32 candidate : std::as_const(candidates)) {
+            const HeatPoint point = m_points.at(candidate);
+            const QPointF offset = mapping.map(point.pos) - center;
+            const qreal dist2 = offset.x() * offset.x() + offset.y() * offset.y();
+            if (dist2 < reach * reach)
+                density += HeatMapKernels::kernelValue(params.falloff, radius, dist2) * peakOf(point);
+        }
+    });
+    return density;
+}
 
-    // 非归一化视为原始背景分辨率坐标，需按缩放比例映射
-    if (!m_baseImage.isNull() && !targetRect.isEmpty()) {
-        qreal scaleX = targetRect.width() / m_baseImage.width();
-        qreal scaleY = targetRect.height() / m_baseImage.height();
-        return QPointF(targetRect.left() + pos.x() * scaleX,
-                       targetRect.top() + pos.y() * scaleY);
-    }
+QVector<qsizetype> HeatMapOverlay::pointsInRect(const QRectF &rect) const
+{
+    const HeatMapRenderParams params = renderParams();
+    return spatialIndex().pointsInRect(m_points, rect.normalized(), queryWindowBegin(params),
+                                       HeatMapRenderer::pointEnd(params, m_points));
+}
 
-    return pos;
+QVector<HeatMapHotspot> HeatMapOverlay::topHotspots(int k) const
+{
+    // 渲染器正被后台任务使用时不等待，沿用上一次的结果
+    if (m_renderer) {
+        const HeatMapRenderParams params = renderParams();
+        m_hotspots = m_renderer->findHotspots(k, HeatMapRenderer::displayRadius(params));
+        for (HeatMapHotspot &hotspot : m_hotspots)
+            hotspot.position = HeatMapRenderer::mapFromDisplay(params, hotspot.position);
+    }
+    return m_hotspots.mid(0, qMax(0, k));
 }
 
-qreal HeatMapOverlay::effectiveRadius() const
+QRectF HeatMapOverlay::displayRect() const
 {
-    if (!m_adaptivePointRadius)
-        return m_pointRadius;
+    return imageDisplayRect();
+}
 
-    qreal scale = 1.0;
-    QRectF rect = imageDisplayRect();
+QRectF HeatMapOverlay::imageDisplayRect() const
+{
+    return HeatMapImageRenderer::imageDisplayRect(size(), m_baseImage.size(), renderConfig().scaleMode);
+}
 
-    if (!m_baseImage.isNull() && !rect.isEmpty()) {
-        qreal sx = rect.width() / m_baseImage.width();
-        qreal sy = rect.height() / m_baseImage.height();
-        scale = qMin(sx, sy);
-    } else if (m_normalizedCoords) {
-        scale = qMin(width(), height());
+HeatMapRenderConfig HeatMapOverlay::renderConfig() const
+{
+    HeatMapRenderConfig config;
+    config.scaleMode = (m_scaleMode == FitInside) ? HeatMapRenderConfig::ScaleMode::FitInside
+                                                  : HeatMapRenderConfig::ScaleMode::CoverWidget;
+    config.pointRadius = m_pointRadius;
+    config.falloff = (m_kernelShape == GaussianKernel) ? HeatMapKernels::Falloff::Gaussian
+                                                       : HeatMapKernels::Falloff::Linear;
+    switch (m_densityMode) {
+    case AutomaticDensity:
+        config.densityMethod = HeatMapRenderParams::DensityMethod::Automatic;
+        break;
+    case StampedDensity:
+        config.densityMethod = HeatMapRenderParams::DensityMethod::Stamped;
+        break;
+    case BinnedDensity:
+        config.densityMethod = HeatMapRenderParams::DensityMethod::Binned;
+        break;
+    }
+    config.binningThreshold = m_binningThreshold;
+    switch (m_timeMode) {
+    case AllTime:
+        config.timeMode = HeatMapRenderParams::TimeMode::AllTime;
+        break;
+    case SlidingWindow:
+        config.timeMode = HeatMapRenderParams::TimeMode::SlidingWindow;
+        break;
+    case ExponentialDecay:
+        config.timeMode = HeatMapRenderParams::TimeMode::ExponentialDecay;
+        break;
     }
+    config.timeWindow = m_timeWindow;
+    config.decayHalfLife = m_decayHalfLife;
+    config.densityResolution = m_densityResolution;
+    config.keyframeBudget = m_keyframeBudget;
+    switch (m_renderScale) {
+    case FullResolution:
+        config.renderScale = 1.0;
+        break;
+    case HalfResolution:
+        config.renderScale = 0.5;
+        break;
+    case QuarterResolution:
+        config.renderScale = 0.25;
+        break;
+    case AutomaticResolution:
+        config.renderScale = 0.0;
+        break;
+    }
+    config.adaptivePointRadius = m_adaptivePointRadius;
+    config.heatmapOpacity = m_heatmapOpacity;
+    config.autoNormalize = m_autoNormalize;
+    config.normalization = (m_normalizationMode == PercentileNormalization)
+                               ? HeatMapRenderParams::Normalization::Percentile
+                               : HeatMapRenderParams::Normalization::Maximum;
+    config.normalizePercentile = m_normalizePercentile;
+    switch (m_intensityCurve) {
+    case LinearCurve:
+        config.intensityCurve = HeatMapRenderParams::IntensityCurve::Linear;
+        break;
+    case LogarithmicCurve:
+        config.intensityCurve = HeatMapRenderParams::IntensityCurve::Logarithmic;
+        break;
+    case GammaCurve:
+        config.intensityCurve = HeatMapRenderParams::IntensityCurve::Gamma;
+        break;
+    }
+    config.intensityGamma = m_intensityGamma;
+    config.normalizedCoordinates = m_normalizedCoords;
+    config.coldColor = m_coldColor;
+    config.hotColor = m_hotColor;
+    config.colorStops = m_colorStops;
+    config.showCrosshair = m_showCrosshair;
+    return config;
+}
 
-    return qMax<qreal>(1.0, m_pointRadius * scale);
+void HeatMapOverlay::setRenderConfig(const HeatMapRenderConfig &config)
+{
+    setScaleMode(config.scaleMode == HeatMapRenderConfig::ScaleMode::FitInside ? FitInside : CoverWidget);
+    setPointRadius(config.pointRadius);
+    setKernelShape(config.falloff == HeatMapKernels::Falloff::Gaussian ? GaussianKernel : LinearKernel);
+    switch (config.densityMethod) {
+    case HeatMapRenderParams::DensityMethod::Automatic:
+        setDensityMode(AutomaticDensity);
+        break;
+    case HeatMapRenderParams::DensityMethod::Stamped:
+        setDensityMode(StampedDensity);
+        break;
+    case HeatMapRenderParams::DensityMethod::Binned:
+        setDensityMode(BinnedDensity);
+        break;
+    }
+    setBinningThreshold(config.binningThreshold);
+    switch (config.timeMode) {
+    case HeatMapRenderParams::TimeMode::AllTime:
+        setTimeMode(AllTime);
+        break;
+    case HeatMapRenderParams::TimeMode::SlidingWindow:
+        setTimeMode(SlidingWindow);
+        break;
+    case HeatMapRenderParams::TimeMode::ExponentialDecay:
+        setTimeMode(ExponentialDecay);
+        break;
+    }
+    setTimeWindow(config.timeWindow);
+    setDecayHalfLife(config.decayHalfLife);
+    setDensityResolution(config.densityResolution);
+    setKeyframeBudget(config.keyframeBudget);
+    if (config.renderScale <= 0.0)
+        setRenderScale(AutomaticResolution);
+    else
+        setRenderScale(config.renderScale >= 1.0 ? FullResolution
+                       : config.renderScale >= 0.5 ? HalfResolution
+                                                   : QuarterResolution);
+    setAdaptivePointRadius(config.adaptivePointRadius);
+    setHeatmapOpacity(config.heatmapOpacity);
+    setAutoNormalize(config.autoNormalize);
+    setNormalizationMode(config.normalization == HeatMapRenderParams::Normalization::Percentile
+                             ? PercentileNormalization
+                             : MaximumNormalization);
+    setNormalizePercentile(config.normalizePercentile);
+    switch (config.intensityCurve) {
+    case HeatMapRenderParams::IntensityCurve::Linear:
+        setIntensityCurve(LinearCurve);
+        break;
+    case HeatMapRenderParams::IntensityCurve::Logarithmic:
+        setIntensityCurve(LogarithmicCurve);
+        break;
+    case HeatMapRenderParams::IntensityCurve::Gamma:
+        setIntensityCurve(GammaCurve);
+        break;
+    }
+    setIntensityGamma(config.intensityGamma);
+    setNormalizedCoordinates(config.normalizedCoordinates);
+    setColdColor(config.coldColor);
+    setHotColor(config.hotColor);
+    setColorStops(config.colorStops);
+    setShowCrosshair(config.showCrosshair);
 }
 
-void HeatMapOverlay::colorizeHeatmap(QImage &heatmap) const
+HeatMapRenderParams HeatMapOverlay::renderParams(qreal renderScale) const
 {
-    // 将灰度 alpha 转换为渐变色
-    if (heatmap.format() != QImage::Format_ARGB32_Premultiplied)
-        heatmap = heatmap.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    HeatMapRenderConfig config = renderConfig();
+    config.renderScale = renderScale;
+    // 回放时以回放位置作为当前时间，滑动窗口与衰减随之回放
+    HeatMapRenderParams params = HeatMapImageRenderer::renderParams(config, size(), m_baseImage.size(),
+                                                                    m_playbackActive ? m_playbackPosition : m_timeNow);
+    params.clipToNow = m_playbackActive;
+    return params;
+}
 
-    uchar *bits = heatmap.bits();
-    const int pixelCount = heatmap.width() * heatmap.height();
+void HeatMapOverlay::scheduleRender()
+{
+    // 任务结束后会再次 update()，届时处理期间积累的变化
+    if (m_activeJob || width() <= 0 || height() <= 0)
+        return;
 
-    for (int i = 0; i < pixelCount; ++i) {
-        int index = i * 4;
-        const uchar alpha = bits[index + 3];
-        if (alpha == 0) {
-            bits[index + 0] = bits[index + 1] = bits[index + 2] = 0;
-            continue;
-        }
+    applyRenderScale();
+    m_renderer->invalidate(m_pendingStages);
+    m_pendingStages = 0;
 
-        // 根据 alpha 比例插值颜色
-        qreal t = alpha / 255.0;
-        QColor color(
-            static_cast<int>(m_coldColor.red() + (m_hotColor.red() - m_coldColor.red()) * t),
-            static_cast<int>(m_coldColor.green() + (m_hotColor.green() - m_coldColor.green()) * t),
-            static_cast<int>(m_coldColor.blue() + (m_hotColor.blue() - m_coldColor.blue()) * t),
-            alpha);
-
-        bits[index + 0] = static_cast<uchar>(color.blue());
-        bits[index + 1] = static_cast<uchar>(color.green());
-        bits[index + 2] = static_cast<uchar>(color.red());
-    }
-}
+    const HeatMapRenderParams params = renderParams();
+    if (m_renderer->isUpToDate(params, m_points))
+        return;
 
-void HeatMapOverlay::regenerateCache()
-{
-    if (width() <= 0 || height() <= 0) {
-        m_cachedHeatmap = QImage();
+    // 只追加了少量点击时在 GUI 线程增量叠加，开销 O(radius²)，避免一次线程往返
+    if (m_frame.isNull() && m_renderer->hasOnlyIncrementalWork(params, m_points)) {
+        m_renderer->render(params, m_points);
+        collectRenderStats(*m_renderer);
         return;
     }
 
-    QImage heatmap(size(), QImage::Format_ARGB32_Premultiplied);
-    heatmap.fill(Qt::transparent);
-
-    QPainter heatPainter(&heatmap);
-    heatPainter.setRenderHint(QPainter::Antialiasing, true);
-    heatPainter.setCompositionMode(QPainter::CompositionMode_Plus);
+    startRenderJob(params);
+}
 
-    const qreal radius = effectiveRadius();
+void HeatMapOverlay::startRenderJob(const HeatMapRenderParams &params)
+{
+    auto job = std::make_shared<RenderJob>();
+    job->params = params;
+    job->points = m_points; // 隐式共享，GUI 线程追加点击时才会复制
+    if (m_frame.isNull())
+        m_frame = m_renderer->image(); // 保留上一帧用于显示，工作线程写入时自动分离
+    job->renderer = std::move(m_renderer);
+    m_activeJob = job;
 
-    // 遍历点击点，使用径向渐变叠加 alpha
-    for (const HeatPoint &heatPoint : m_points) {
-        QPointF mapped = mapToDisplay(heatPoint.pos);
+    m_renderPool.start([this, job]() {
+        job->completed = job->renderer->render(job->params, job->points, &job->cancelled);
+        // 先投递收尾再释放信号量：析构函数等到信号量后，本对象不再被工作线程引用
+        QMetaObject::invokeMethod(this, [this, job]() { finishRenderJob(job); }, Qt::QueuedConnection);
+        job->finished.release();
+    });
+}
 
-        QRadialGradient g(mapped, radius);
-        QColor centerColor = QColor(255, 255, 255, static_cast<int>(180 * heatPoint.weight));
-        QColor edgeColor = QColor(255, 255, 255, 0);
-        g.setColorAt(0.0, centerColor);
-        g.setColorAt(1.0, edgeColor);
+void HeatMapOverlay::finishRenderJob(const std::shared_ptr<RenderJob> &job)
+{
+    // waitForIdle() 可能已同步收尾，此时排队的调用直接忽略
+    if (job != m_activeJob)
+        return;
 
-        heatPainter.setBrush(g);
-        heatPainter.setPen(Qt::NoPen);
-        heatPainter.drawEllipse(mapped, radius, radius);
+    m_activeJob.reset();
+    m_renderer = std::move(job->renderer);
+    collectRenderStats(*m_renderer);
+    // 被取消的任务输出不完整，继续显示旧帧，直到下一次完整渲染
+    if (job->completed) {
+        m_frame = QImage();
+        if (!job->cancelled)
+            emit frameReady();
     }
+    update();
+}
 
-    heatPainter.end();
-
-    if (m_autoNormalize) {
-        // 寻找最大 alpha 用于归一化，避免局部过曝
-        uchar maxAlpha = 0;
-        const uchar *bits = heatmap.constBits();
-        const int pixelCount = heatmap.width() * heatmap.height();
-        for (int i = 0; i < pixelCount; ++i) {
-            maxAlpha = qMax(maxAlpha, bits[i * 4 + 3]);
-        }
-        if (maxAlpha > 0 && maxAlpha < 255) {
-            QImage normalized = heatmap;
-            uchar *mutableBits = normalized.bits();
-            for (int i = 0; i < pixelCount; ++i) {
-                int idx = i * 4 + 3;
-                mutableBits[idx] = static_cast<uchar>((mutableBits[idx] / static_cast<float>(maxAlpha)) * 255);
-            }
-            heatmap = normalized;
-        }
+void HeatMapOverlay::waitForIdle()
+{
+    if (m_activeJob) {
+        const std::shared_ptr<RenderJob> job = m_activeJob;
+        job->finished.acquire();
+        finishRenderJob(job);
     }
+    if (width() <= 0 || height() <= 0)
+        return;
 
-    colorizeHeatmap(heatmap);
-    m_cachedHeatmap = heatmap;
-    m_dirty = false;
+    // 剩余工作在调用线程同步完成
+    applyRenderScale();
+    m_renderer->invalidate(m_pendingStages);
+    m_pendingStages = 0;
+    const HeatMapRenderParams params = renderParams();
+    if (m_renderer->isUpToDate(params, m_points) && m_frame.isNull())
+        return;
+    m_renderer->render(params, m_points);
+    collectRenderStats(*m_renderer);
+    m_frame = QImage();
+    emit frameReady();
+    update();
 }
@@ -2,12 +2,25 @@
 
 #include <QWidget>
 #include <QImage>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSpan>
+#include <QThreadPool>
 #include <QColor>
+#include <QBrush>
 #include <QVector>
 #include <QPointF>
 #include <QRectF>
 #include <QtUiPlugin/QDesignerExportWidget>
 
+#include <memory>
+
+#include "HeatMapClickQueue.h"
+#include "HeatMapImageRenderer.h"
+#include "HeatMapRenderer.h"
+#include "HeatMapSpatialIndex.h"
+#include "HeatMapTileCache.h"
+
 // 鼠标点击热力图覆盖控件：可以作为透明蒙版覆盖在任意图片或界面上，
 // 通过绘制热力图展示用户点击的热点分布。
 class QDESIGNER_WIDGET_EXPORT HeatMapOverlay : public QWidget
@@ -20,20 +33,66 @@ class QDESIGNER_WIDGET_EXPORT HeatMapOverlay : public QWidget
     Q_PROPERTY(QVector<QPointF> clickPoints READ clickPoints WRITE setClickPoints NOTIFY clickPointsChanged)
     // 热力点半径，控制模糊范围
     Q_PROPERTY(int pointRadius READ pointRadius WRITE setPointRadius NOTIFY pointRadiusChanged)
+    // 热力点衰减形状：线性或高斯
+    Q_PROPERTY(KernelShape kernelShape READ kernelShape WRITE setKernelShape NOTIFY kernelShapeChanged)
+    // 密度计算方式：逐点叠加、网格分箱 + 模糊，或按点数自动选择
+    Q_PROPERTY(DensityMode densityMode READ densityMode WRITE setDensityMode NOTIFY densityModeChanged)
+    // 随时间变化的统计方式：全部历史、滑动窗口或指数衰减
+    Q_PROPERTY(TimeMode timeMode READ timeMode WRITE setTimeMode NOTIFY timeModeChanged)
+    // 滑动窗口长度（毫秒）
+    Q_PROPERTY(int timeWindow READ timeWindow WRITE setTimeWindow NOTIFY timeModeChanged)
+    // 指数衰减的半衰期（毫秒）
+    Q_PROPERTY(int decayHalfLife READ decayHalfLife WRITE setDecayHalfLife NOTIFY timeModeChanged)
+    // 自动模式下切换到分箱模糊的点数阈值
+    Q_PROPERTY(int binningThreshold READ binningThreshold WRITE setBinningThreshold NOTIFY densityModeChanged)
+    // 密度场规范分辨率的长边上限（像素），0 表示始终按控件分辨率计算
+    Q_PROPERTY(int densityResolution READ densityResolution WRITE setDensityResolution NOTIFY densityResolutionChanged)
+    // 回放关键帧的内存上限（MB），0 表示按密度场大小自动选择
+    Q_PROPERTY(int keyframeBudget READ keyframeBudget WRITE setKeyframeBudget NOTIFY keyframeBudgetChanged)
+    // 并行渲染的工作线程数，0 表示按 CPU 核数自动选择
+    Q_PROPERTY(int workerThreadCount READ workerThreadCount WRITE setWorkerThreadCount NOTIFY workerThreadCountChanged)
     // 是否随背景缩放半径，保证热区大小与缩放比例一致
     Q_PROPERTY(bool adaptivePointRadius READ adaptivePointRadius WRITE setAdaptivePointRadius NOTIFY adaptivePointRadiusChanged)
     // 热力图整体透明度，便于查看背景
     Q_PROPERTY(qreal heatmapOpacity READ heatmapOpacity WRITE setHeatmapOpacity NOTIFY heatmapOpacityChanged)
     // 是否自动归一化强度，避免过曝
     Q_PROPERTY(bool autoNormalize READ autoNormalize WRITE setAutoNormalize NOTIFY autoNormalizeChanged)
+    // 自动归一化的参考密度：最大值，或非零像素的分位数（抑制单个离群热点）
+    Q_PROPERTY(NormalizationMode normalizationMode READ normalizationMode WRITE setNormalizationMode NOTIFY normalizationChanged)
+    // 分位数归一化使用的分位数（0~1），如 0.99
+    Q_PROPERTY(qreal normalizePercentile READ normalizePercentile WRITE setNormalizePercentile NOTIFY normalizationChanged)
+    // 归一化强度到色带的映射曲线
+    Q_PROPERTY(IntensityCurve intensityCurve READ intensityCurve WRITE setIntensityCurve NOTIFY intensityCurveChanged)
+    // GammaCurve 的指数，小于 1 时提亮低强度区域
+    Q_PROPERTY(qreal intensityGamma READ intensityGamma WRITE setIntensityGamma NOTIFY intensityCurveChanged)
+    // 紧凑点存储：归一化坐标量化为 16 位、权重量化为 8 位，大数据集时大幅降低内存占用
+    Q_PROPERTY(bool compactPointStorage READ compactPointStorage WRITE setCompactPointStorage NOTIFY compactPointStorageChanged)
     // 是否使用归一化坐标（0~1），便于随背景缩放
     Q_PROPERTY(bool normalizedCoordinates READ normalizedCoordinates WRITE setNormalizedCoordinates NOTIFY normalizedCoordinatesChanged)
     // 颜色起点（冷色）
     Q_PROPERTY(QColor coldColor READ coldColor WRITE setColdColor NOTIFY colorRampChanged)
     // 颜色终点（热点）
     Q_PROPERTY(QColor hotColor READ hotColor WRITE setHotColor NOTIFY colorRampChanged)
+    // 多段渐变色带（位置 0~1），非空时取代冷/热两色渐变，颜色与 alpha 均取自色带
+    Q_PROPERTY(QGradientStops colorStops READ colorStops WRITE setColorStops NOTIFY colorRampChanged)
     // 是否显示辅助十字线，用于调试定位
     Q_PROPERTY(bool showCrosshair READ showCrosshair WRITE setShowCrosshair NOTIFY showCrosshairChanged)
+    // 在左上角叠加每帧统计（需以 HEATMAP_ENABLE_INSTRUMENTATION 构建，否则不绘制）
+    Q_PROPERTY(bool showStatsHud READ showStatsHud WRITE setShowStatsHud NOTIFY showStatsHudChanged)
+    // 热力图的渲染分辨率：全分辨率、1/2、1/4，或自动（缩放窗口与播放时按半径降低，空闲时恢复全分辨率）
+    Q_PROPERTY(RenderScale renderScale READ renderScale WRITE setRenderScale NOTIFY renderScaleChanged)
+    // 视口缩放倍数（1~32）。大于 1 时热力图按视口分块计算，只渲染可见区域
+    Q_PROPERTY(qreal zoom READ zoom WRITE setZoom NOTIFY viewportChanged)
+    // 视口左上角在未缩放画面中的位置（控件像素）
+    Q_PROPERTY(QPointF panOffset READ panOffset WRITE setPanOffset NOTIFY viewportChanged)
+    // 是否响应滚轮缩放与中键/右键拖动平移；关闭时控件对鼠标事件透明
+    Q_PROPERTY(bool interactiveViewport READ interactiveViewport WRITE setInteractiveViewport NOTIFY interactiveViewportChanged)
+    // 时间轴回放是否正在播放
+    Q_PROPERTY(bool playing READ isPlaying NOTIFY playbackStateChanged)
+    // 回放位置（毫秒时间戳），只显示时间戳不晚于该位置的点击
+    Q_PROPERTY(qint64 playbackPosition READ playbackPosition WRITE seek NOTIFY playbackPositionChanged)
+    // 回放速度倍数，1 为按实际时间播放
+    Q_PROPERTY(qreal playbackSpeed READ playbackSpeed WRITE setPlaybackSpeed NOTIFY playbackSpeedChanged)
 
 public:
     // 控件缩放策略：适配背景以完整呈现或铺满裁剪
@@ -43,82 +102,353 @@ public:
     };
     Q_ENUM(ScaleMode)
 
+    // 热力点衰减形状
+    enum KernelShape {
+        LinearKernel,   // 线性衰减，到半径处为 0
+        GaussianKernel  // 高斯衰减，与 scripts/generate_sample_heatmap.py 的模型一致
+    };
+    Q_ENUM(KernelShape)
+
+    // 密度计算方式
+    enum DensityMode {
+        AutomaticDensity, // 点数达到 binningThreshold 时使用分箱模糊，否则逐点叠加
+        StampedDensity,   // 逐点叠加核印章，开销随点数线性增长
+        BinnedDensity     // 先按显示分辨率分箱，再做可分离模糊，开销 O(像素 + 点数)
+    };
+    Q_ENUM(DensityMode)
+
+    // 随时间变化的统计方式
+    enum TimeMode {
+        AllTime,          // 累计全部历史
+        SlidingWindow,    // 只显示最近 timeWindow 毫秒内的点击，过期点增量扣除
+        ExponentialDecay  // 点击强度按 decayHalfLife 指数衰减，整幅衰减不需要重新叠加
+    };
+    Q_ENUM(TimeMode)
+
+    // 自动归一化的参考密度
+    enum NormalizationMode {
+        MaximumNormalization,   // 最大密度映射为满强度
+        PercentileNormalization // normalizePercentile 分位数映射为满强度，更高的密度显示为最热颜色
+    };
+    Q_ENUM(NormalizationMode)
+
+    // 归一化强度到色带的映射曲线，只影响调色板
+    enum IntensityCurve {
+        LinearCurve,
+        LogarithmicCurve, // 对数压缩，突出低强度区域的层次
+        GammaCurve        // 按 intensityGamma 做幂次映射
+    };
+    Q_ENUM(IntensityCurve)
+
+    // 热力图的渲染分辨率。热力图本身平滑，降低分辨率后双线性放大几乎看不出差别，
+    // 重采样、归一化与着色的开销随像素数成比例下降
+    enum RenderScale {
+        FullResolution,
+        HalfResolution,
+        QuarterResolution,
+        AutomaticResolution // 缩放窗口或播放期间降低分辨率（缩小后的半径不少于 8 像素），空闲时细化为全分辨率
+    };
+    Q_ENUM(RenderScale)
+
+    using HeatPoint = HeatMapRenderer::HeatPoint;
+
     explicit HeatMapOverlay(QWidget *parent = nullptr);
+    ~HeatMapOverlay() override;
 
-    // 数据接口
-    void addClick(const QPointF &pos, qreal weight = 1.0);
+    // 常见眼动热图色带：透明→蓝→绿→黄→红
+    static QGradientStops eyeTrackingColorStops();
+
+    // 数据接口。时间戳为毫秒（Unix 纪元），小于 0 时取当前时间；
+    // 时间戳须单调不减，早于上一个点的时间戳按上一个点处理
+    void addClick(const QPointF &pos, qreal weight = 1.0, qint64 timestamp = -1);
+    // 批量追加带权重与时间戳的点击，只触发一次重绘，下一帧增量叠加整批点
+    void addClicks(QSpan<const HeatPoint> clicks);
     void clearClicks();
+    // 为内存中共 count 个点击预留存储（不含 loadClicks() 映射的点），已知会话规模时避免追加过程中逐步扩容
+    void reserveClicks(qsizetype count);
+    // 加载点击日志（见 HeatMapClickLog）：内存映射文件并直接在映射上渲染，不拷贝到内存；
+    // 坐标模式随文件切换，之后追加的点击存放在内存中。失败时保留原有数据
+    bool loadClicks(const QString &path, QString *errorString = nullptr);
+    // 把全部点击保存为点击日志，记录当前坐标模式与底图尺寸
+    bool saveClicks(const QString &path, QString *errorString = nullptr) const;
+    // 供采集线程推送点击的无锁队列（单生产者）。控件按最高约 60Hz 的节拍取出，
+    // 把两帧之间到达的点合并为一次增量更新；控件销毁前须停止推送
+    HeatMapClickQueue *clickQueue() { return &m_clickQueue; }
+    // 只读的点击数据视图，不做任何拷贝；下次修改点击数据前有效
+    const HeatMapPointStore &points() const { return m_points; }
+
+    // 全部可视属性的快照，可交给 HeatMapImageRenderer 离屏渲染出与控件一致的图像；
+    // setRenderConfig() 逐项调用属性设置函数（如应用 config/heatmap_config.json）
+    HeatMapRenderConfig renderConfig() const;
+    void setRenderConfig(const HeatMapRenderConfig &config);
 
     // 属性访问器
     ScaleMode scaleMode() const { return m_scaleMode; }
     QImage baseImage() const { return m_baseImage; }
     QVector<QPointF> clickPoints() const;
     int pointRadius() const { return m_pointRadius; }
+    KernelShape kernelShape() const { return m_kernelShape; }
+    DensityMode densityMode() const { return m_densityMode; }
+    int binningThreshold() const { return m_binningThreshold; }
+    TimeMode timeMode() const { return m_timeMode; }
+    int timeWindow() const { return m_timeWindow; }
+    int decayHalfLife() const { return m_decayHalfLife; }
+    int densityResolution() const { return m_densityResolution; }
+    int keyframeBudget() const { return m_keyframeBudget; }
+    RenderScale renderScale() const { return m_renderScale; }
+    int workerThreadCount() const { return m_workerThreadCount; }
     bool adaptivePointRadius() const { return m_adaptivePointRadius; }
     qreal heatmapOpacity() const { return m_heatmapOpacity; }
     bool autoNormalize() const { return m_autoNormalize; }
+    NormalizationMode normalizationMode() const { return m_normalizationMode; }
+    qreal normalizePercentile() const { return m_normalizePercentile; }
+    IntensityCurve intensityCurve() const { return m_intensityCurve; }
+    qreal intensityGamma() const { return m_intensityGamma; }
     bool normalizedCoordinates() const { return m_normalizedCoords; }
+    bool compactPointStorage() const { return m_compactPointStorage; }
     QColor coldColor() const { return m_coldColor; }
     QColor hotColor() const { return m_hotColor; }
+    QGradientStops colorStops() const { return m_colorStops; }
     bool showCrosshair() const { return m_showCrosshair; }
-    // 实际绘制背景及热力图的区域，便于外部做坐标映射或命中检测
+    bool showStatsHud() const { return m_showStatsHud; }
+    qreal zoom() const { return m_zoom; }
+    QPointF panOffset() const { return m_panOffset; }
+    bool interactiveViewport() const { return m_interactiveViewport; }
+    // 时间轴回放：play() 或 seek() 进入回放，热力图只统计时间戳不晚于回放位置的点击，
+    // stopPlayback() 退出并恢复显示全部点击。累计模式下进入回放时按点数保存若干密度关键帧，
+    // 拖动时间轴只需从最近的关键帧增量补齐；其他时间模式向后跳转时重新累积
+    bool isPlaying() const { return m_playing; }
+    bool isPlaybackActive() const { return m_playbackActive; }
+    qint64 playbackPosition() const { return m_playbackPosition; }
+    qreal playbackSpeed() const { return m_playbackSpeed; }
+    // 时间轴范围：第一个与最后一个点击的时间戳，无点击时为 0
+    qint64 playbackStartTime() const { return m_points.isEmpty() ? 0 : m_points.at(0).timestamp; }
+    qint64 playbackEndTime() const { return m_points.lastTimestamp(); }
+    // 实际绘制背景及热力图的区域（未缩放的画面坐标），便于外部做坐标映射或命中检测
     QRectF displayRect() const;
 
+    // 查询接口：坐标与 clickPoints 相同（归一化坐标或背景像素坐标），只统计当前时间模式下参与显示的点。
+    // 均由空间索引只访问相关网格中的点，不等待后台渲染。
+    // pos 处的密度，单位同 HeatMapRenderer::maxDensity()（权重为 1 的单个点击中心为 180，衰减模式下按当前时间衰减）
+    float densityAt(const QPointF &pos) const;
+    // 落在 rect 内的点在 points() 中的下标，升序
+    QVector<qsizetype> pointsInRect(const QRectF &rect) const;
+    // 密度最强的至多 k 个热点（位置为点坐标），彼此相距至少一个热力点半径。
+    // 基于最近一次完成的渲染；后台渲染进行中时返回上一次的结果
+    QVector<HeatMapHotspot> topHotspots(int k) const;
+
+    // 视口：控件坐标到未缩放画面坐标的映射，缩放后的点击须先经此映射再与 displayRect() 比较
+    QPointF mapToContent(const QPointF &widgetPos) const;
+    // 以控件坐标 widgetPos 为中心把缩放倍数乘以 factor，该点下的内容保持不动
+    void zoomAt(const QPointF &widgetPos, qreal factor);
+
+    // 阻塞直到后台渲染结束并完成所有排队的渲染工作，供导出与测试使用
+    void waitForIdle();
+
+    // 最近一次绘制的统计：渲染各阶段（含其间完成的后台任务）、背景缩放与合成。
+    // 未启用 HEATMAP_INSTRUMENTATION 时始终为零
+    HeatMapFrameStats frameStats() const { return m_frameStats; }
+
 public slots:
     void setScaleMode(ScaleMode mode);
     void setBaseImage(const QImage &image);
     void setClickPoints(const QVector<QPointF> &points);
     void setPointRadius(int radius);
+    void setKernelShape(KernelShape shape);
+    void setDensityMode(DensityMode mode);
+    void setBinningThreshold(int count);
+    void setTimeMode(TimeMode mode);
+    void setTimeWindow(int milliseconds);
+    void setDecayHalfLife(int milliseconds);
+    void setDensityResolution(int pixels);
+    void setKeyframeBudget(int megabytes);
+    void setRenderScale(RenderScale scale);
+    void setWorkerThreadCount(int count);
     void setAdaptivePointRadius(bool on);
     void setHeatmapOpacity(qreal value);
     void setAutoNormalize(bool on);
+    void setNormalizationMode(NormalizationMode mode);
+    void setNormalizePercentile(qreal percentile);
+    void setIntensityCurve(IntensityCurve curve);
+    void setIntensityGamma(qreal gamma);
     void setNormalizedCoordinates(bool on);
+    void setCompactPointStorage(bool on);
     void setColdColor(const QColor &color);
     void setHotColor(const QColor &color);
+    void setColorStops(const QGradientStops &stops);
     void setShowCrosshair(bool on);
+    void setShowStatsHud(bool on);
+    // 以控件中心为基准缩放
+    void setZoom(qreal zoom);
+    void setPanOffset(const QPointF &offset);
+    void setInteractiveViewport(bool on);
+    // 恢复为不缩放、不平移
+    void resetViewport();
+    // 从当前回放位置开始播放，未在回放或已播放到末尾时从第一个点击开始
+    void play();
+    void pause();
+    // 跳转到时间戳 position（限制在时间轴范围内），未在回放时进入暂停的回放
+    void seek(qint64 position);
+    void setPlaybackSpeed(qreal speed);
+    void stopPlayback();
 
 signals:
     void scaleModeChanged();
     void baseImageChanged();
     void clickPointsChanged();
     void pointRadiusChanged();
+    void kernelShapeChanged();
+    void densityModeChanged();
+    void timeModeChanged();
+    void densityResolutionChanged();
+    void keyframeBudgetChanged();
+    void renderScaleChanged();
+    void workerThreadCountChanged();
     void adaptivePointRadiusChanged();
     void heatmapOpacityChanged();
     void autoNormalizeChanged();
+    void normalizationChanged();
+    void intensityCurveChanged();
     void normalizedCoordinatesChanged();
+    void compactPointStorageChanged();
     void colorRampChanged();
     void showCrosshairChanged();
+    void showStatsHudChanged();
+    void viewportChanged();
+    void interactiveViewportChanged();
+    void playbackStateChanged();
+    void playbackPositionChanged(qint64 position);
+    void playbackSpeedChanged();
+    // 后台渲染完成一帧新的热力图（取消的任务不会发出）
+    void frameReady();
+    // 每次绘制后发出，仅在启用 HEATMAP_INSTRUMENTATION 时
+    void frameStatsUpdated(const HeatMapFrameStats &stats);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
 
 private:
-    void regenerateCache();
+    struct RenderJob;
+
+    void invalidate(uint stages);
+    void appendPoint(const HeatPoint &point);
+    void updateTimeTicking();
+    void enterPlayback();
+    void advancePlayback();
+    void drainClickQueue();
+    void scheduleRender();
+    void startRenderJob(const HeatMapRenderParams &params);
+    void finishRenderJob(const std::shared_ptr<RenderJob> &job);
+    // 按当前渲染分辨率生成渲染器参数；renderScale 为 1 时为未缩放画面的参数（缩放视口与查询使用）
+    HeatMapRenderParams renderParams() const { return renderParams(m_appliedRenderScale); }
+    HeatMapRenderParams renderParams(qreal renderScale) const;
+    qreal effectiveRenderScale() const;
+    void applyRenderScale();
+    void ensureScaledBase(const QSize &targetSize);
+    void invalidateScaledBase();
+    void collectRenderStats(const HeatMapRenderer &renderer);
+    const HeatMapSpatialIndex &spatialIndex() const;
+    qsizetype queryWindowBegin(const HeatMapRenderParams &params) const;
+    void setViewport(qreal zoom, const QPointF &panOffset);
+    HeatMapTileCache::Viewport viewport() const { return {m_zoom, m_panOffset}; }
+    void paintViewport(QPainter &painter, const QRectF &targetRect, const QImage &frame);
     QRectF imageDisplayRect() const;
-    QPointF mapToDisplay(const QPointF &pos) const;
-    qreal effectiveRadius() const;
-    void colorizeHeatmap(QImage &heatmap) const;
 
     ScaleMode m_scaleMode = CoverWidget;
     QImage m_baseImage;
-    struct HeatPoint
-    {
-        QPointF pos;
-        qreal weight = 1.0;
-    };
 
-    QVector<HeatPoint> m_points; // 存储点击坐标，若为归一化则范围 0~1
+    // 缩放后的背景缓存，按目标尺寸、缩放模式与是否平滑缩放区分；
+    // 交互式缩放窗口期间先用快速缩放，停止后再细化为平滑缩放
+    QImage m_scaledBase;
+    QSize m_scaledBaseSize;
+    ScaleMode m_scaledBaseMode = CoverWidget;
+    bool m_scaledBaseSmooth = false;
+    QTimer m_resizeSettleTimer;
+
+    HeatMapPointStore m_points; // 列式存储的点击数据，坐标若为归一化则范围 0~1
+    mutable QVector<QPointF> m_clickPointsCache; // clickPoints() 的解码结果，数据变化时清空
+    // 点坐标的网格索引，查询或缩放视口用到时才把新增点加入；点数据被替换时清空
+    mutable HeatMapSpatialIndex m_spatialIndex;
+    mutable QVector<HeatMapHotspot> m_hotspots; // 上一次 topHotspots() 的结果
+    bool m_compactPointStorage = false;
+
+    // 流式采集：队列有新数据时唤醒一次，与上次合入间隔不足一帧则用单次定时器推迟
+    static constexpr int kIngestIntervalMs = 16;
+    HeatMapClickQueue m_clickQueue;
+    QVector<HeatPoint> m_ingestBuffer;
+    QElapsedTimer m_ingestClock;
+    QTimer m_ingestTimer;
+
+    // 时间模式：按固定节拍推进当前时间，窗口滑动与衰减只在节拍上更新
+    static constexpr int kTimeTickMs = 50;
+    TimeMode m_timeMode = AllTime;
+    int m_timeWindow = 30000;
+    int m_decayHalfLife = 10000;
+    qint64 m_timeNow = 0;
+    QTimer m_timeTickTimer;
+
+    // 回放：播放时按帧节拍从 m_playbackClock 推算位置，位置 = 起点 + 经过时间 × 速度
+    bool m_playbackActive = false;
+    bool m_playing = false;
+    qint64 m_playbackPosition = 0;
+    qint64 m_playbackOrigin = 0; // m_playbackClock 开始计时时的回放位置
+    qreal m_playbackSpeed = 1.0;
+    QElapsedTimer m_playbackClock;
+    QTimer m_playbackTimer;
 
     int m_pointRadius = 25;
+    KernelShape m_kernelShape = LinearKernel;
+    DensityMode m_densityMode = AutomaticDensity;
+    int m_binningThreshold = 200000;
+    int m_densityResolution = 2048;
+    int m_keyframeBudget = 0;
+    // 自动渲染分辨率下缩小后半径的下限（像素），半径更小时降低分辨率会丢失细节
+    static constexpr qreal kMinScaledRadius = 8.0;
+    RenderScale m_renderScale = FullResolution;
+    qreal m_appliedRenderScale = 1.0; // 渲染器当前使用的分辨率倍数，只在发起渲染前更新
     bool m_adaptivePointRadius = true;
     qreal m_heatmapOpacity = 0.65;
     bool m_autoNormalize = true;
+    NormalizationMode m_normalizationMode = MaximumNormalization;
+    qreal m_normalizePercentile = 0.99;
+    IntensityCurve m_intensityCurve = LinearCurve;
+    qreal m_intensityGamma = 0.5;
     bool m_normalizedCoords = true;
     QColor m_coldColor = QColor(0, 120, 255);
     QColor m_hotColor = QColor(255, 0, 0);
+    QGradientStops m_colorStops;
     bool m_showCrosshair = false;
+    bool m_showStatsHud = false;
+
+    // 两次绘制之间累计的统计，绘制结束时转存为 m_frameStats
+    HeatMapFrameStats m_pendingStats;
+    HeatMapFrameStats m_frameStats;
+
+    // 后台渲染与双缓冲：渲染器整体交给工作线程执行一次任务，期间 GUI 线程
+    // 继续绘制 m_frame（上一帧的共享副本，尺寸不符时拉伸显示）；
+    // 任务期间的失效累积在 m_pendingStages，并请求任务尽快取消。
+    // 与背景的合成（含透明度）始终在 paintEvent 中完成
+    std::unique_ptr<HeatMapRenderer> m_renderer; // 任务执行期间为空
+    std::shared_ptr<RenderJob> m_activeJob;
+    QImage m_frame;
+    uint m_pendingStages = HeatMapRenderer::AllStages;
+
+    int m_workerThreadCount = 0;
+    QThreadPool m_renderPool;
 
-    QImage m_cachedHeatmap;
-    bool m_dirty = true;
+    // 缩放视口：放大后按视口分块渲染，瓦片缓存跨帧复用，平移只需计算新露出的瓦片；
+    // 每帧计算瓦片的时间不超过 kTileBudgetMs，其余瓦片先用整幅热力图放大代替，下一帧继续
+    static constexpr qreal kMaxZoom = 32.0;
+    static constexpr int kTileBudgetMs = 12;
+    qreal m_zoom = 1.0;
+    QPointF m_panOffset;
+    bool m_interactiveViewport = false;
+    bool m_panning = false;
+    QPointF m_panAnchor; // 拖动平移时上一次的鼠标位置（控件坐标）
+    HeatMapTileCache m_tileCache;
 };
@@ -0,0 +1,345 @@
+#include "HeatMapPointStore.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr qreal kCoordinateSteps = 65535.0;
+constexpr qreal kWeightSteps = 16.0;
+
+quint16 encodeCoordinate(qreal value)
+{
+    return static_cast<quint16>(qRound(qBound<qreal>(0.0, value, 1.0) * kCoordinateSteps));
+}
+
+quint8 encodeWeight(qreal weight)
+{
+    return static_cast<quint8>(qBound(1, qRound(weight * kWeightSteps), 255));
+}
+
+// 8 位权重能否表示 weight（按步长量化，但不截断到范围之内）
+bool fitsCompactWeight(qreal weight)
+{
+    const qreal steps = weight * kWeightSteps;
+    return steps >= 1.0 && steps <= 255.0;
+}
+
+// 封存的内存块各列，由外部块的共享所有权保持
+struct SealedColumns
+{
+    QVector<quint16> compactX;
+    QVector<quint16> compactY;
+    QVector<float> x;
+    QVector<float> y;
+    QVector<quint8> compactWeight;
+    QVector<float> weight;
+    QVector<quint32> timeOffset;
+};
+
+qint64 blockTimestamp(const HeatMapPointStore::Block &block, qsizetype index)
+{
+    return block.timeOffsets ? block.timeBase + block.timeOffsets[index] : block.timeBase;
+}
+
+// 每列一次顺序遍历，按列分派编码而不是逐点判断
+void decodeBlock(const HeatMapPointStore::Block &block, qsizetype first, qsizetype count, HeatMapPoint *out)
+{
+    if (block.compactCoordinates) {
+        const quint16 *xs = static_cast<const quint16 *>(block.x) + first;
+        const quint16 *ys = static_cast<const quint16 *>(block.y) + first;
+        for (qsizetype i = 0; i < count; ++i)
+            out[i].pos = QPointF(xs[i] / kCoordinateSteps, ys[i] / kCoordinateSteps);
+    } else {
+        const float *xs = static_cast<const float *>(block.x) + first;
+        const float *ys = static_cast<const float *>(block.y) + first;
+        for (qsizetype i = 0; i < count; ++i)
+            out[i].pos = QPointF(xs[i], ys[i]);
+    }
+
+    if (!block.weights) {
+        for (qsizetype i = 0; i < count; ++i)
+            out[i].weight = 1.0;
+    } else if (block.compactWeights) {
+        const quint8 *weights = static_cast<const quint8 *>(block.weights) + first;
+        for (qsizetype i = 0; i < count; ++i)
+            out[i].weight = weights[i] / kWeightSteps;
+    } else {
+        const float *weights = static_cast<const float *>(block.weights) + first;
+        for (qsizetype i = 0; i < count; ++i)
+            out[i].weight = weights[i];
+    }
+
+    if (block.timeOffsets) {
+        const quint32 *offsets = block.timeOffsets + first;
+        for (qsizetype i = 0; i < count; ++i)
+            out[i].timestamp = block.timeBase + offsets[i];
+    } else {
+        for (qsizetype i = 0; i < count; ++i)
+            out[i].timestamp = block.timeBase;
+    }
+}
+
+// 块内第一个时间戳不早于 timestamp 的下标，块内时间戳单调不减
+qsizetype blockLowerBound(const HeatMapPointStore::Block &block, qint64 timestamp, qsizetype from)
+{
+    if (timestamp <= block.timeBase)
+        return from;
+    if (!block.timeOffsets)
+        return block.count;
+    const quint32 offset = static_cast<quint32>(qMin<qint64>(timestamp - block.timeBase,
+                                                             std::numeric_limits<quint32>::max()));
+    return std::lower_bound(block.timeOffsets + from, block.timeOffsets + block.count, offset) - block.timeOffsets;
+}
+
+} // namespace
+
+void HeatMapPointStore::setCompact(bool compactCoordinates, bool compactWeights)
+{
+    if (compactCoordinates == m_compactCoordinates && compactWeights == m_compactWeights)
+        return;
+
+    // 先按旧编码解码内存中的点，再按新编码重新追加
+    QVector<HeatMapPoint> points(m_count);
+    decodeBlock(memoryBlock(), 0, m_count, points.data());
+    const QVector<Block> external = m_external;
+    const QVector<std::shared_ptr<const void>> owners = m_externalOwners;
+    const qsizetype sealedBytes = m_sealedBytes;
+    clear();
+    for (qsizetype i = 0; i < external.size(); ++i)
+        appendBlock(external.at(i), owners.at(i));
+    m_sealedBytes = sealedBytes;
+    m_compactCoordinates = compactCoordinates;
+    m_compactWeights = compactWeights;
+    m_compactWeightColumn = compactWeights;
+    reserve(points.size());
+    for (const HeatMapPoint &point : std::as_const(points))
+        append(point);
+}
+
+void HeatMapPointStore::reserve(qsizetype count)
+{
+    if (m_compactCoordinates) {
+        m_compactX.reserve(count);
+        m_compactY.reserve(count);
+    } else {
+        m_x.reserve(count);
+        m_y.reserve(count);
+    }
+    if (!m_compactWeight.isEmpty())
+        m_compactWeight.reserve(count);
+    if (!m_weight.isEmpty())
+        m_weight.reserve(count);
+    if (!m_timeOffset.isEmpty())
+        m_timeOffset.reserve(count);
+}
+
+void HeatMapPointStore::clear()
+{
+    m_external.clear();
+    m_externalStarts.clear();
+    m_externalOwners.clear();
+    m_externalCount = 0;
+    m_sealedBytes = 0;
+
+    m_count = 0;
+    m_compactX.clear();
+    m_compactY.clear();
+    m_x.clear();
+    m_y.clear();
+    m_compactWeight.clear();
+    m_weight.clear();
+    m_timeBase = 0;
+    m_timeOffset.clear();
+    m_compactWeightColumn = m_compactWeights;
+}
+
+void HeatMapPointStore::append(const HeatMapPoint &point)
+{
+    // 时间戳偏移超出 32 位时开始新块，而不是截断
+    if (m_count > 0 && point.timestamp - m_timeBase > std::numeric_limits<quint32>::max())
+        sealMemoryBlock();
+
+    if (m_compactCoordinates) {
+        m_compactX.append(encodeCoordinate(point.pos.x()));
+        m_compactY.append(encodeCoordinate(point.pos.y()));
+    } else {
+        m_x.append(static_cast<float>(point.pos.x()));
+        m_y.append(static_cast<float>(point.pos.y()));
+    }
+
+    // 权重列在第一次出现不为 1 的权重时才分配，并为之前的点补齐；
+    // 8 位编码表示不了的权重（如 addClick() 的下限 0.01）使权重列改为 float
+    if (m_compactWeightColumn && !fitsCompactWeight(point.weight))
+        widenWeights();
+    if (m_compactWeightColumn) {
+        if (m_compactWeight.isEmpty() && encodeWeight(point.weight) != encodeWeight(1.0))
+            m_compactWeight.fill(encodeWeight(1.0), m_count);
+        if (!m_compactWeight.isEmpty())
+            m_compactWeight.append(encodeWeight(point.weight));
+    } else {
+        if (m_weight.isEmpty() && point.weight != 1.0)
+            m_weight.fill(1.0f, m_count);
+        if (!m_weight.isEmpty())
+            m_weight.append(static_cast<float>(point.weight));
+    }
+
+    // 时间戳列同理；早于块首的时间戳（违反单调要求）按块首记录
+    if (m_count == 0)
+        m_timeBase = point.timestamp;
+    const qint64 offset = qBound<qint64>(0, point.timestamp - m_timeBase, std::numeric_limits<quint32>::max());
+    if (m_timeOffset.isEmpty() && offset != 0)
+        m_timeOffset.fill(0, m_count);
+    if (!m_timeOffset.isEmpty())
+        m_timeOffset.append(static_cast<quint32>(offset));
+
+    ++m_count;
+}
+
+void HeatMapPointStore::appendExternal(const Block &block, const std::shared_ptr<const void> &owner)
+{
+    Q_ASSERT(m_count == 0);
+    appendBlock(block, owner);
+}
+
+void HeatMapPointStore::appendBlock(const Block &block, const std::shared_ptr<const void> &owner)
+{
+    if (block.count <= 0)
+        return;
+    m_external.append(block);
+    m_externalStarts.append(m_externalCount);
+    m_externalOwners.append(owner);
+    m_externalCount += block.count;
+}
+
+void HeatMapPointStore::sealMemoryBlock()
+{
+    // 移动不改变各列的数据地址，之前取得的块视图仍然有效
+    const Block block = memoryBlock();
+    m_sealedBytes = byteSize();
+    auto columns = std::make_shared<SealedColumns>();
+    columns->compactX = std::move(m_compactX);
+    columns->compactY = std::move(m_compactY);
+    columns->x = std::move(m_x);
+    columns->y = std::move(m_y);
+    columns->compactWeight = std::move(m_compactWeight);
+    columns->weight = std::move(m_weight);
+    columns->timeOffset = std::move(m_timeOffset);
+    appendBlock(block, columns);
+
+    m_count = 0;
+    m_compactX.clear();
+    m_compactY.clear();
+    m_x.clear();
+    m_y.clear();
+    m_compactWeight.clear();
+    m_weight.clear();
+    m_timeBase = 0;
+    m_timeOffset.clear();
+    m_compactWeightColumn = m_compactWeights;
+}
+
+void HeatMapPointStore::widenWeights()
+{
+    if (!m_compactWeight.isEmpty()) {
+        m_weight.reserve(m_compactWeight.capacity());
+        for (quint8 weight : std::as_const(m_compactWeight))
+            m_weight.append(static_cast<float>(weight / kWeightSteps));
+        m_compactWeight.clear();
+    }
+    m_compactWeightColumn = false;
+}
+
+HeatMapPointStore::Block HeatMapPointStore::memoryBlock() const
+{
+    Block block;
+    block.count = m_count;
+    block.compactCoordinates = m_compactCoordinates;
+    block.compactWeights = m_compactWeightColumn;
+    block.x = m_compactCoordinates ? static_cast<const void *>(m_compactX.constData()) : m_x.constData();
+    block.y = m_compactCoordinates ? static_cast<const void *>(m_compactY.constData()) : m_y.constData();
+    if (m_compactWeightColumn && !m_compactWeight.isEmpty())
+        block.weights = m_compactWeight.constData();
+    else if (!m_compactWeightColumn && !m_weight.isEmpty())
+        block.weights = m_weight.constData();
+    block.timeOffsets = m_timeOffset.isEmpty() ? nullptr : m_timeOffset.constData();
+    block.timeBase = m_timeBase;
+    return block;
+}
+
+QVector<HeatMapPointStore::Block> HeatMapPointStore::blocks() const
+{
+    QVector<Block> result = m_external;
+    if (m_count > 0)
+        result.append(memoryBlock());
+    return result;
+}
+
+HeatMapPoint HeatMapPointStore::at(qsizetype index) const
+{
+    HeatMapPoint point;
+    decode(index, 1, &point);
+    return point;
+}
+
+qsizetype HeatMapPointStore::externalBlockAt(qsizetype index) const
+{
+    if (index >= m_externalCount)
+        return m_external.size();
+    return std::upper_bound(m_externalStarts.cbegin(), m_externalStarts.cend(), index) - m_externalStarts.cbegin() - 1;
+}
+
+qint64 HeatMapPointStore::timestampAt(qsizetype index) const
+{
+    if (index < m_externalCount) {
+        const qsizetype block = externalBlockAt(index);
+        return blockTimestamp(m_external.at(block), index - m_externalStarts.at(block));
+    }
+    index -= m_externalCount;
+    return m_timeOffset.isEmpty() ? m_timeBase : m_timeBase + m_timeOffset.at(index);
+}
+
+void HeatMapPointStore::decode(qsizetype first, qsizetype count, HeatMapPoint *out) const
+{
+    // 从 first 所在的外部块起依次解码，其余部分落在内存块上
+    for (qsizetype block = externalBlockAt(first); count > 0 && block < m_external.size(); ++block) {
+        const qsizetype offset = first - m_externalStarts.at(block);
+        const qsizetype n = qMin(count, m_external.at(block).count - offset);
+        decodeBlock(m_external.at(block), offset, n, out);
+        out += n;
+        count -= n;
+        first += n;
+    }
+    if (count > 0)
+        decodeBlock(memoryBlock(), first - m_externalCount, count, out);
+}
+
+qsizetype HeatMapPointStore::lowerBoundTimestamp(qint64 timestamp, qsizetype from) const
+{
+    from = qBound<qsizetype>(0, from, size());
+    // 时间戳单调不减，各块末尾的时间戳也单调：先二分出第一个末尾不早于 timestamp 的块，再在块内二分。
+    // 不复制块列表（滑动窗口与回放每个节拍都会调用）
+    if (from < m_externalCount) {
+        const auto begin = m_external.cbegin() + externalBlockAt(from);
+        const auto it = std::lower_bound(begin, m_external.cend(), timestamp, [](const Block &block, qint64 value) {
+            return blockTimestamp(block, block.count - 1) < value;
+        });
+        if (it != m_external.cend()) {
+            const qsizetype start = m_externalStarts.at(it - m_external.cbegin());
+            return start + blockLowerBound(*it, timestamp, qMax<qsizetype>(0, from - start));
+        }
+    }
+    if (m_count > 0) {
+        const Block block = memoryBlock();
+        if (blockTimestamp(block, m_count - 1) >= timestamp)
+            return m_externalCount + blockLowerBound(block, timestamp, qMax<qsizetype>(0, from - m_externalCount));
+    }
+    return size();
+}
+
+qsizetype HeatMapPointStore::byteSize() const
+{
+    return m_sealedBytes + m_compactX.size() * qsizetype(sizeof(quint16)) * 2 + m_x.size() * qsizetype(sizeof(float)) * 2
+           + m_compactWeight.size() * qsizetype(sizeof(quint8)) + m_weight.size() * qsizetype(sizeof(float))
+           + m_timeOffset.size() * qsizetype(sizeof(quint32));
+}
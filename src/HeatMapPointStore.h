@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QPointF>
+#include <QVector>
+
+#include <memory>
+
+// 单个点击：位置、权重与毫秒时间戳（通常为 Unix 纪元时间）
+struct HeatMapPoint
+{
+    QPointF pos;
+    qreal weight = 1.0;
+    qint64 timestamp = 0;
+};
+
+// 列式（structure-of-arrays）点击存储，面向数百万点的数据集：
+// - 坐标按列存放，紧凑模式下归一化坐标量化为 16 位（步长 1/65535），否则为 float；
+// - 权重列只在出现不为 1 的权重时才分配，紧凑模式下量化为 8 位（步长 1/16，范围 1/16 ~ 255/16），
+//   出现超出该范围的权重时内存块的权重列改为 float，不截断；
+// - 时间戳列只在出现不同时间戳时才分配，存为相对块内首个点的 32 位毫秒偏移；
+//   偏移超出 32 位（约 49.7 天）时封存当前内存块，之后的点开始新块。
+// 紧凑模式下常见的等权重、同批次点击每个只占 4 字节。
+//
+// 数据由若干只读的外部块（如内存映射的点击日志，不拷贝）与其后可追加的内存块组成。
+// 各列均为隐式共享的 QVector 或共享所有权的外部内存，整体拷贝不复制数据，可直接作为后台渲染的快照。
+class HeatMapPointStore
+{
+public:
+    // decode() 单次解码的建议块大小，调用方可用栈上缓冲
+    static constexpr qsizetype kDecodeChunk = 256;
+
+    // 一段列式数据的原始视图，列指针按 compactCoordinates / compactWeights 解释；
+    // weights 为空表示权重全为 1，timeOffsets 为空表示时间戳全为 timeBase
+    struct Block
+    {
+        qsizetype count = 0;
+        bool compactCoordinates = false; // x、y 为 quint16，否则为 float
+        bool compactWeights = false;     // weights 为 quint8，否则为 float
+        const void *x = nullptr;
+        const void *y = nullptr;
+        const void *weights = nullptr;
+        const quint32 *timeOffsets = nullptr;
+        qint64 timeBase = 0;
+    };
+
+    qsizetype size() const { return m_externalCount + m_count; }
+    bool isEmpty() const { return size() == 0; }
+
+    // 紧凑编码：compactCoordinates 仅适用于 0~1 归一化坐标（超出部分会被截断）。
+    // 编码变化时按新方式重新编码内存中的点，外部块保持原有编码
+    void setCompact(bool compactCoordinates, bool compactWeights);
+    bool compactCoordinates() const { return m_compactCoordinates; }
+    bool compactWeights() const { return m_compactWeights; }
+
+    // 为共 count 个内存中的点预留坐标列，以及已经分配的权重与时间戳列
+    void reserve(qsizetype count);
+    void clear();
+    void append(const HeatMapPoint &point);
+    // 引用外部只读内存中的一段数据而不拷贝；owner 保证内存在所有副本销毁前有效。
+    // 只能在追加内存中的点之前调用
+    void appendExternal(const Block &block, const std::shared_ptr<const void> &owner);
+
+    HeatMapPoint at(qsizetype index) const;
+    qint64 lastTimestamp() const { return isEmpty() ? 0 : timestampAt(size() - 1); }
+    // 把 [first, first + count) 解码到 out，逐列顺序读取
+    void decode(qsizetype first, qsizetype count, HeatMapPoint *out) const;
+    // 第一个时间戳不早于 timestamp 的点的下标（从 from 开始查找），要求时间戳单调不减
+    qsizetype lowerBoundTimestamp(qint64 timestamp, qsizetype from = 0) const;
+
+    // 按存储顺序列出全部数据块（外部块在前），指针在下次修改前有效，供序列化直接写出各列
+    QVector<Block> blocks() const;
+    // 内存中各列（含封存的内存块）实际占用的字节数，不含外部块
+    qsizetype byteSize() const;
+
+private:
+    Block memoryBlock() const;
+    qint64 timestampAt(qsizetype index) const;
+    // 包含下标 index 的外部块序号（按各块起点二分查找）；index 落在内存块时返回外部块数
+    qsizetype externalBlockAt(qsizetype index) const;
+    void appendBlock(const Block &block, const std::shared_ptr<const void> &owner);
+    // 把内存块的各列移交给共享的持有者，作为只读块接在外部块之后，内存块从空开始
+    void sealMemoryBlock();
+    // 紧凑权重列改为 float 列
+    void widenWeights();
+
+    // 外部只读块及其第一个点的下标（前缀和），由记录进程逐批追加的日志可能有大量小块
+    QVector<Block> m_external;
+    QVector<qsizetype> m_externalStarts;
+    QVector<std::shared_ptr<const void>> m_externalOwners; // 每块一个
+    qsizetype m_externalCount = 0;
+    qsizetype m_sealedBytes = 0;
+
+    // 外部块之后可追加的内存块
+    qsizetype m_count = 0;
+    bool m_compactCoordinates = false;
+    bool m_compactWeights = false;
+    bool m_compactWeightColumn = false; // 内存块权重列的实际编码，紧凑模式下可能已改为 float
+
+    QVector<quint16> m_compactX;
+    QVector<quint16> m_compactY;
+    QVector<float> m_x;
+    QVector<float> m_y;
+    QVector<quint8> m_compactWeight; // 为空表示全部权重为 1
+    QVector<float> m_weight;         // 为空表示全部权重为 1
+    qint64 m_timeBase = 0;           // 内存块首个点的时间戳
+    QVector<quint32> m_timeOffset;   // 为空表示全部时间戳等于 m_timeBase
+};
@@ -0,0 +1,1028 @@
+#include "HeatMapRenderer.h"
+
+#include <QThreadPool>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// 密度场是否受两组参数之间差异的影响；规范分辨率下密度场与输出尺寸、显示区域无关
+bool fieldDiffers(const HeatMapRenderParams &a, const HeatMapRenderParams &b)
+{
+    if (a.canonicalSize != b.canonicalSize || a.radius != b.radius || a.falloff != b.falloff
+        || a.normalizedCoordinates != b.normalizedCoordinates || a.baseImageSize != b.baseImageSize)
+        return true;
+    return b.canonicalSize.isEmpty() && (a.size != b.size || a.displayRect != b.displayRect);
+}
+
+// 调整缓冲大小；启用统计时，容量增长计入新分配的字节数
+template <typename T>
+void resizeBuffer(QVector<T> &buffer, qsizetype size, HeatMapFrameStats &stats)
+{
+    HEATMAP_STATS(if (size > buffer.capacity()) {
+        stats.bytesAllocated += size * qsizetype(sizeof(T));
+        ++stats.allocations;
+    });
+    Q_UNUSED(stats);
+    buffer.resize(size);
+}
+
+// 按块顺序解码 [first, last) 的点并逐个处理：列式存储逐列连续读取，解码缓冲在栈上
+template <typename Fn>
+void forEachPoint(const HeatMapPointStore &points, qsizetype first, qsizetype last, Fn &&fn)
+{
+    HeatMapPoint chunk[HeatMapPointStore::kDecodeChunk];
+    for (qsizetype begin = first; begin < last; begin += HeatMapPointStore::kDecodeChunk) {
+        const qsizetype count = qMin(HeatMapPointStore::kDecodeChunk, last - begin);
+        points.decode(begin, count, chunk);
+        for (qsizetype i = 0; i < count; ++i)
+            fn(begin + i, chunk[i]);
+    }
+}
+
+} // namespace
+
+HeatMapPointMapping HeatMapRenderer::displayMapping(const HeatMapRenderParams &params)
+{
+    const QRectF &targetRect = params.displayRect;
+    HeatMapPointMapping mapping;
+
+    if (params.normalizedCoordinates) {
+        if (targetRect.isEmpty()) {
+            mapping.scaleX = params.size.width();
+            mapping.scaleY = params.size.height();
+            return mapping;
+        }
+        mapping.scaleX = targetRect.width();
+        mapping.scaleY = targetRect.height();
+        mapping.offsetX = targetRect.left();
+        mapping.offsetY = targetRect.top();
+        return mapping;
+    }
+
+    // 非归一化视为原始背景分辨率坐标，需按缩放比例映射
+    if (!params.baseImageSize.isEmpty() && !targetRect.isEmpty()) {
+        mapping.scaleX = targetRect.width() / params.baseImageSize.width();
+        mapping.scaleY = targetRect.height() / params.baseImageSize.height();
+        mapping.offsetX = targetRect.left();
+        mapping.offsetY = targetRect.top();
+    }
+    return mapping;
+}
+
+QPointF HeatMapRenderer::mapToDisplay(const HeatMapRenderParams &params, const QPointF &pos)
+{
+    return displayMapping(params).map(pos);
+}
+
+QPointF HeatMapRenderer::mapFromDisplay(const HeatMapRenderParams &params, const QPointF &pos)
+{
+    const QRectF &targetRect = params.displayRect;
+
+    if (params.normalizedCoordinates) {
+        if (targetRect.isEmpty())
+            return params.size.isEmpty() ? QPointF()
+                                         : QPointF(pos.x() / params.size.width(), pos.y() / params.size.height());
+
+        return QPointF((pos.x() - targetRect.left()) / targetRect.width(),
+                       (pos.y() - targetRect.top()) / targetRect.height());
+    }
+
+    if (!params.baseImageSize.isEmpty() && !targetRect.isEmpty()) {
+        return QPointF((pos.x() - targetRect.left()) * params.baseImageSize.width() / targetRect.width(),
+                       (pos.y() - targetRect.top()) * params.baseImageSize.height() / targetRect.height());
+    }
+
+    return pos;
+}
+
+qreal HeatMapRenderer::displayRadius(const HeatMapRenderParams &params)
+{
+    if (params.canonicalSize.isEmpty())
+        return params.radius;
+    return params.radius * params.displayRect.width() / params.canonicalSize.width();
+}
+
+HeatMapPointMapping HeatMapRenderer::fieldMapping() const
+{
+    if (!usesCanonicalField())
+        return displayMapping(m_params);
+
+    // 规范分辨率的密度场覆盖整幅背景：归一化坐标按场尺寸缩放，原始坐标按背景分辨率换算
+    const QSize &field = m_params.canonicalSize;
+    HeatMapPointMapping mapping;
+    mapping.scaleX = field.width();
+    mapping.scaleY = field.height();
+    if (!m_params.normalizedCoordinates) {
+        mapping.scaleX /= m_params.baseImageSize.width();
+        mapping.scaleY /= m_params.baseImageSize.height();
+    }
+    return mapping;
+}
+
+template <typename Fn>
+void HeatMapRenderer::forEachStampedPoint(const HeatMapPointStore &points, qsizetype first, qsizetype last,
+                                          Fn &&fn) const
+{
+    const HeatMapPointMapping mapping = m_fieldMapping;
+    withPeakFunction(m_params, m_decayOrigin, [&](auto peakOf) {
+        forEachPoint(points, first, last, [&](qsizetype index, const HeatPoint &point) {
+            fn(index, mapping.map(point.pos), peakOf(point));
+        });
+    });
+}
+
+void HeatMapRenderer::invalidate(uint stages)
+{
+    // 上游阶段失效时，其下游阶段必然需要重跑；几何阶段是否连带密度阶段由 updateGeometry() 判断
+    if (stages & (GeometryStage | DensityStage))
+        stages |= ResampleStage;
+    if (stages & ResampleStage)
+        stages |= NormalizeStage;
+    if (stages & NormalizeStage)
+        stages |= ColorizeStage;
+    m_dirtyStages |= stages;
+}
+
+bool HeatMapRenderer::usesBinning(const HeatMapRenderParams &params, qsizetype pointCount) const
+{
+    if (params.densityMethod == HeatMapRenderParams::DensityMethod::Automatic)
+        return pointCount >= params.binningThreshold;
+    return params.densityMethod == HeatMapRenderParams::DensityMethod::Binned;
+}
+
+qsizetype HeatMapRenderer::windowBegin(const HeatMapRenderParams &params, const HeatMapPointStore &points,
+                                       qsizetype from)
+{
+    if (params.timeMode != HeatMapRenderParams::TimeMode::SlidingWindow)
+        return from;
+    // 时间戳单调不减，二分查找第一个仍在窗口内的点
+    return points.lowerBoundTimestamp(params.windowStart, from);
+}
+
+qsizetype HeatMapRenderer::pointEnd(const HeatMapRenderParams &params, const HeatMapPointStore &points)
+{
+    return params.clipToNow ? points.lowerBoundTimestamp(params.now + 1) : points.size();
+}
+
+bool HeatMapRenderer::usesKeyframes() const
+{
+    return m_params.clipToNow && m_params.timeMode == HeatMapRenderParams::TimeMode::AllTime;
+}
+
+bool HeatMapRenderer::normalizationOutdated(const HeatMapRenderParams &params) const
+{
+    // 衰减模式下不自动归一化时，整幅强度随时间下降，归一化系数需跟随当前时间
+    return params.timeMode == HeatMapRenderParams::TimeMode::ExponentialDecay && !params.autoNormalize
+           && params.now != m_normalizedNow;
+}
+
+bool HeatMapRenderer::isUpToDate(const HeatMapRenderParams &params, const HeatMapPointStore &points) const
+{
+    const qsizetype end = pointEnd(params, points);
+    return m_dirtyStages == 0 && m_stampedCount == end
+           && windowBegin(params, points, m_windowBegin) == m_windowBegin
+           && !normalizationOutdated(params)
+           && (m_image.isNull() || usesBinning(params, end) == m_binnedActive);
+}
+
+bool HeatMapRenderer::hasOnlyIncrementalWork(const HeatMapRenderParams &params, const HeatMapPointStore &points) const
+{
+    // 分箱模式的增量需要整幅重新模糊，整图重新归一化或一次进出大批点也不算作廉价工作；
+    // 回放向后跳转只在累计模式下可以增量扣除
+    const qsizetype end = pointEnd(params, points);
+    if (m_dirtyStages != 0 || m_image.isNull() || m_binnedActive || usesBinning(params, end)
+        || normalizationOutdated(params)
+        || (m_stampedCount > end && params.timeMode != HeatMapRenderParams::TimeMode::AllTime))
+        return false;
+    const qsizetype entering = qMax<qsizetype>(0, end - m_stampedCount);
+    const qsizetype leaving = windowBegin(params, points, m_windowBegin) - m_windowBegin
+                              + qMax<qsizetype>(0, m_stampedCount - end);
+    return entering + leaving <= kIncrementalPointLimit;
+}
+
+bool HeatMapRenderer::render(const HeatMapRenderParams &params, const HeatMapPointStore &points,
+                             const std::atomic<bool> *cancel)
+{
+    m_params = params;
+    m_fieldMapping = fieldMapping();
+    m_cancel = cancel;
+    HEATMAP_STATS(m_stats = HeatMapFrameStats(); m_stats.renderPasses = 1);
+
+    // 自动模式下点数跨过分箱阈值时，需要按新方式重新累积；
+    // 回放在滑动窗口或衰减模式下向后跳转时，过期点的进出无法增量还原，同样重新累积
+    const qsizetype end = pointEnd(params, points);
+    if (!(m_dirtyStages & DensityStage) && !m_image.isNull() && usesBinning(params, end) != m_binnedActive)
+        invalidate(DensityStage);
+    if (end < m_stampedCount && params.timeMode != HeatMapRenderParams::TimeMode::AllTime)
+        invalidate(DensityStage);
+    if (!usesKeyframes() && !m_keyframes.isEmpty()) {
+        m_keyframes.clear();
+        m_keyframeInterval = 0;
+    }
+    if (normalizationOutdated(params))
+        invalidate(NormalizeStage);
+
+    if (m_dirtyStages & GeometryStage) {
+        HEATMAP_TIME_SCOPE(m_stats.geometryNs);
+        if (!updateGeometry())
+            return true;
+        m_dirtyStages &= ~GeometryStage;
+    }
+
+    if (m_dirtyStages & DensityStage) {
+        HEATMAP_TIME_SCOPE(m_stats.densityNs);
+        if (!accumulateDensity(points))
+            return false;
+        m_dirtyStages &= ~DensityStage;
+    } else {
+        HEATMAP_TIME_SCOPE(m_stats.densityNs);
+        // 衰减增益离时间基准过远时先整体缩放，再按新基准增量叠加
+        if (params.timeMode == HeatMapRenderParams::TimeMode::ExponentialDecay
+            && params.now - m_decayOrigin > kDecayRebaseHalfLives * qMax<qint64>(1, params.decayHalfLife))
+            rebaseDecay();
+        if (usesKeyframes())
+            restoreNearestKeyframe(end);
+        if (m_stampedCount != end || windowBegin(params, points, m_windowBegin) > m_windowBegin)
+            updatePointsIncrementally(points);
+    }
+
+    if (m_dirtyStages & ResampleStage) {
+        HEATMAP_TIME_SCOPE(m_stats.resampleNs);
+        if (!resampleField())
+            return false;
+        m_dirtyStages &= ~ResampleStage;
+    }
+
+    if (m_dirtyStages & NormalizeStage) {
+        HEATMAP_TIME_SCOPE(m_stats.normalizeNs);
+        updateNormalization();
+        m_dirtyStages &= ~NormalizeStage;
+    }
+
+    if (m_dirtyStages & ColorizeStage) {
+        HEATMAP_TIME_SCOPE(m_stats.colorizeNs);
+        if (!colorize(m_image.rect()))
+            return false;
+        m_dirtyStages &= ~ColorizeStage;
+    }
+
+    m_cancel = nullptr;
+    return true;
+}
+
+bool HeatMapRenderer::updateGeometry()
+{
+    // 几何阶段：分配输出缓冲；密度场的尺寸、半径或坐标映射变化时重建核印章并使密度阶段失效
+    if (m_params.size.isEmpty()) {
+        m_field.clear();
+        m_density.clear();
+        m_histogram.clear();
+        m_fieldSize = QSize();
+        m_mipBuilt = 0;
+        m_image = QImage();
+        m_spareImage = QImage();
+        m_stampedCount = 0;
+        m_maxDensity = 0.0f;
+        return false;
+    }
+
+    if (m_image.size() != m_params.size) {
+        // 备用缓冲恰好是目标尺寸时直接换用（如自动渲染分辨率在两档之间切换）
+        if (m_spareImage.size() == m_params.size && m_spareImage.isDetached()) {
+            std::swap(m_image, m_spareImage);
+        } else {
+            m_image = QImage(m_params.size, QImage::Format_ARGB32_Premultiplied);
+            HEATMAP_STATS(m_stats.bytesAllocated += m_image.sizeInBytes(); ++m_stats.allocations);
+        }
+    }
+
+    if (m_fieldSize.isEmpty() || fieldDiffers(m_fieldParams, m_params)) {
+        m_fieldSize = usesCanonicalField() ? m_params.canonicalSize : m_params.size;
+        resizeBuffer(m_field, static_cast<qsizetype>(m_fieldSize.width()) * m_fieldSize.height(), m_stats);
+        // 仅当有效半径（含自适应缩放）或衰减形状变化时才会重建核
+        HEATMAP_STATS(const bool kernelCached = m_stamp.radius() == m_params.radius
+                                                && m_stamp.falloff() == m_params.falloff;
+                      ++(kernelCached ? m_stats.kernelCacheHits : m_stats.kernelCacheMisses));
+        m_stamp.configure(m_params.radius, m_params.falloff);
+        m_fieldParams = m_params;
+        invalidate(DensityStage);
+    }
+
+    if (usesCanonicalField())
+        resizeBuffer(m_density, static_cast<qsizetype>(m_params.size.width()) * m_params.size.height(), m_stats);
+    else
+        m_density.clear();
+    return true;
+}
+
+float HeatMapRenderer::decayFactor() const
+{
+    if (m_params.timeMode != HeatMapRenderParams::TimeMode::ExponentialDecay)
+        return 1.0f;
+    const qreal halfLife = qMax<qint64>(1, m_params.decayHalfLife);
+    return static_cast<float>(std::exp2(-(m_params.now - m_decayOrigin) / halfLife));
+}
+
+float HeatMapRenderer::pointPeak(const HeatMapRenderParams &params, const HeatPoint &point, qint64 decayOrigin)
+{
+    // 中心强度 180 * weight，与原径向渐变一致；衰减模式下按相对时间基准的增益叠加，
+    // 显示时再统一乘以 decayFactor()，整幅衰减无需重新叠加
+    float peak = 0.0f;
+    withPeakFunction(params, decayOrigin, [&](auto peakOf) { peak = peakOf(point); });
+    return peak;
+}
+
+
+void HeatMapRenderer::rebaseDecay()
+{
+    // 把时间基准移到当前时间：密度场整体乘以累计衰减，开销 O(像素)，每 kDecayRebaseHalfLives 个半衰期一次
+    const float factor = decayFactor();
+    for (float &value : m_field)
+        value *= factor;
+    for (float &value : m_histogram)
+        value *= factor;
+    m_decayOrigin = m_params.now;
+    m_mipBuilt = 0;
+    invalidate(ResampleStage);
+}
+
+void HeatMapRenderer::binPoint(const QPointF &center, float peak)
+{
+    // 每个点只贡献与核总质量相同的质量，模糊后峰值与逐点叠加一致
+    HeatMapKernels::splatBilinear(m_histogram.data(), m_fieldSize.width(), m_fieldSize.height(), center,
+                                  peak * m_stamp.mass());
+}
+
+void HeatMapRenderer::blurBinnedDensity()
+{
+    // 直方图保持不变以便后续增量分箱，模糊在密度场上原地进行
+    std::copy(m_histogram.cbegin(), m_histogram.cend(), m_field.begin());
+    HeatMapKernels::gaussianBlur(m_field.data(), m_fieldSize.width(), m_fieldSize.height(),
+                                 m_stamp.equivalentSigma(), m_blurScratch);
+}
+
+QRect HeatMapRenderer::stampPoint(const QPointF &center, float peak)
+{
+    // 以 float 累加，不会在 255 处饱和；peak 为负时扣除已过期的点
+    return m_stamp.stamp(m_field.data(), m_fieldSize.width(), center, peak, QRect(QPoint(0, 0), m_fieldSize));
+}
+
+void HeatMapRenderer::rebuildPalette()
+{
+    // 仅在颜色或色带变化时重建，逐像素着色只剩一次查表
+    const QColor &cold = m_params.coldColor;
+    const QColor &hot = m_params.hotColor;
+    const QGradientStops &stops = m_params.colorStops;
+    const HeatMapRenderParams::IntensityCurve curve = m_params.intensityCurve;
+    const qreal gamma = m_params.intensityGamma;
+    m_palette.resize(kPaletteSize);
+
+    for (int i = 0; i < kPaletteSize; ++i) {
+        qreal t = static_cast<qreal>(i) / (kPaletteSize - 1);
+        if (curve == HeatMapRenderParams::IntensityCurve::Logarithmic)
+            t = std::log1p(kLogCurveGain * t) / std::log1p(kLogCurveGain);
+        else if (curve == HeatMapRenderParams::IntensityCurve::Gamma)
+            t = std::pow(t, gamma);
+        QColor from = cold;
+        QColor to = hot;
+        qreal local = t;
+        int alpha = static_cast<int>(t * 255);
+
+        if (!stops.isEmpty()) {
+            // 多段色带：定位 t 所在区间，颜色与 alpha 均在区间两端插值
+            int next = 0;
+            while (next < stops.size() && stops.at(next).first < t)
+                ++next;
+            const QGradientStop &hi = stops.at(qMin<int>(next, stops.size() - 1));
+            const QGradientStop &lo = stops.at(qMax(0, next - 1));
+            const qreal span = hi.first - lo.first;
+            from = lo.second;
+            to = hi.second;
+            local = span > 0 ? qBound<qreal>(0.0, (t - lo.first) / span, 1.0) : 0.0;
+            alpha = static_cast<int>(from.alpha() + (to.alpha() - from.alpha()) * local);
+        }
+
+        m_palette[i] = qPremultiply(qRgba(
+            static_cast<int>(from.red() + (to.red() - from.red()) * local),
+            static_cast<int>(from.green() + (to.green() - from.green()) * local),
+            static_cast<int>(from.blue() + (to.blue() - from.blue()) * local),
+            alpha));
+    }
+
+    // 零密度始终完全透明
+    m_palette[0] = 0;
+    m_paletteCold = cold;
+    m_paletteHot = hot;
+    m_paletteStops = stops;
+    m_paletteCurve = curve;
+    m_paletteGamma = gamma;
+}
+
+bool HeatMapRenderer::colorize(const QRect &region)
+{
+    const bool paletteOutdated = m_palette.isEmpty() || m_paletteCold != m_params.coldColor
+                                 || m_paletteHot != m_params.hotColor || m_paletteStops != m_params.colorStops
+                                 || m_paletteCurve != m_params.intensityCurve
+                                 || m_paletteGamma != m_params.intensityGamma;
+    HEATMAP_STATS(++(paletteOutdated ? m_stats.paletteCacheMisses : m_stats.paletteCacheHits));
+    if (paletteOutdated)
+        rebuildPalette();
+    if (region.isEmpty())
+        return true;
+    HEATMAP_STATS(m_stats.pixelsTouched += qsizetype(region.width()) * region.height());
+
+    const float indexScale = m_normalizeScale * (kPaletteSize - 1);
+    const QRgb *palette = m_palette.constData();
+    const float *density = displayDensity();
+    const int stride = m_image.width();
+    // 在调用线程取一次像素指针，避免工作线程各自触发 QImage 的 detach 检查
+    prepareImageForWrite(region != m_image.rect());
+    uchar *bits = m_image.bits();
+    const qsizetype bytesPerLine = m_image.bytesPerLine();
+
+    // 归一化与查表融合为一次向量化遍历，直接写入扫描行；大区域按行带并行，
+    // 每个行带开始前检查取消标志
+    const int bands = (region.height() + kTileSize - 1) / kTileSize;
+    HeatMapKernels::parallelFor(bands > 1 ? m_pool : nullptr, bands, [&](int band) {
+        if (cancelled())
+            return;
+        const int top = region.top() + band * kTileSize;
+        const int bottom = qMin(top + kTileSize - 1, region.bottom());
+        for (int y = top; y <= bottom; ++y) {
+            const float *src = density + static_cast<qsizetype>(y) * stride + region.left();
+            QRgb *dst = reinterpret_cast<QRgb *>(bits + y * bytesPerLine) + region.left();
+            HeatMapKernels::colorize(src, dst, region.width(), indexScale, palette, kPaletteSize);
+        }
+    });
+    return !cancelled();
+}
+
+void HeatMapRenderer::prepareImageForWrite(bool preserveContents)
+{
+    // 图像仍被共享时改写备用缓冲，而不是让 QImage 分离出新副本；
+    // 共享方释放旧帧后，该缓冲成为下一次的备用缓冲。局部着色需要先复制未变化的像素
+    if (m_image.isNull() || m_image.isDetached())
+        return;
+    if (m_spareImage.size() != m_image.size() || !m_spareImage.isDetached()) {
+        m_spareImage = QImage(m_image.size(), QImage::Format_ARGB32_Premultiplied);
+        HEATMAP_STATS(m_stats.bytesAllocated += m_spareImage.sizeInBytes(); ++m_stats.allocations);
+    }
+    if (preserveContents)
+        std::memcpy(m_spareImage.bits(), m_image.constBits(), m_image.sizeInBytes());
+    std::swap(m_image, m_spareImage);
+}
+
+void HeatMapRenderer::updateNormalization()
+{
+    // 自动归一化时参考密度（最大值或分位数）映射为 1，否则沿用 alpha 语义，密度 255 处饱和；
+    // 衰减模式下整幅衰减在这里折算，自动归一化时两者相互抵消。
+    // 参考密度取自瓦片记录，无需扫描整幅图像
+    float reference = m_maxDensity;
+    if (usesPercentile()) {
+        if (!m_intensityHistogramValid)
+            rebuildIntensityHistogram();
+        reference = percentileDensity();
+    }
+    m_normalizeScale = (m_params.autoNormalize && reference > 0.0f) ? 1.0f / reference
+                                                                     : decayFactor() / 255.0f;
+    m_normalizedNow = m_params.now;
+}
+
+bool HeatMapRenderer::accumulateDensity(const HeatMapPointStore &points)
+{
+    m_field.fill(0.0f);
+    m_mipBuilt = 0;
+    m_decayOrigin = m_params.now;
+    m_keyframes.clear();
+    const qsizetype first = windowBegin(m_params, points, 0);
+    const qsizetype end = pointEnd(m_params, points);
+
+    m_binnedActive = usesBinning(m_params, end);
+    if (m_binnedActive) {
+        // 大数据量：先分箱再整体模糊，开销与点数近乎无关
+        resizeBuffer(m_histogram, m_field.size(), m_stats);
+        m_histogram.fill(0.0f);
+    } else {
+        m_histogram.clear();
+    }
+
+    // 回放时一次累积全部点并按间隔保存关键帧，之后的跳转无需从头累积；
+    // 间隔按内存预算与关键帧数上限确定，未设预算时按密度场大小取少量关键帧
+    qsizetype last = end;
+    if (usesKeyframes()) {
+        last = points.size();
+        const qsizetype frameBytes = qMax<qsizetype>(1, m_field.size() * qsizetype(sizeof(float)));
+        const qsizetype budget = m_params.keyframeBudget > 0
+                                     ? m_params.keyframeBudget
+                                     : qMin(frameBytes * kDefaultKeyframes, kDefaultKeyframeBudgetBytes);
+        const qsizetype frames = qBound<qsizetype>(1, budget / frameBytes, kMaxKeyframes);
+        m_keyframeInterval = qMax(kMinKeyframeInterval, (last + frames - 1) / frames);
+    }
+    HEATMAP_STATS(m_stats.pointsStamped += last - first);
+
+    for (qsizetype begin = first; begin < last;) {
+        const qsizetype segmentEnd = usesKeyframes() ? qMin(last, (begin / m_keyframeInterval + 1) * m_keyframeInterval)
+                                                     : last;
+        if (m_binnedActive)
+            forEachStampedPoint(points, begin, segmentEnd,
+                                [this](qsizetype, const QPointF &center, float peak) { binPoint(center, peak); });
+        else if (!stampPoints(points, begin, segmentEnd))
+            return false;
+        if (cancelled())
+            return false;
+        if (usesKeyframes() && segmentEnd % m_keyframeInterval == 0) {
+            m_keyframes.append({segmentEnd, m_binnedActive ? m_histogram : m_field});
+            HEATMAP_STATS(m_stats.bytesAllocated += m_field.size() * qsizetype(sizeof(float)); ++m_stats.allocations);
+        }
+        begin = segmentEnd;
+    }
+    m_stampedCount = last;
+    m_windowBegin = first;
+
+    // 回放位置之后的点由最近的关键帧与增量扣除还原
+    if (usesKeyframes()) {
+        restoreNearestKeyframe(end);
+        if (m_stampedCount != end)
+            updatePointsIncrementally(points);
+        else if (m_binnedActive)
+            blurBinnedDensity();
+    } else if (m_binnedActive) {
+        blurBinnedDensity();
+    }
+    return true;
+}
+
+bool HeatMapRenderer::stampPoints(const HeatMapPointStore &points, qsizetype first, qsizetype last)
+{
+    // 遍历点击点，以缓存的核印章叠加到密度场；点数较多时按瓦片并行
+    if (m_pool && m_pool->maxThreadCount() > 1 && last - first >= kParallelPointThreshold)
+        return stampPointsTiled(points, first, last);
+    forEachStampedPoint(points, first, last,
+                        [this](qsizetype, const QPointF &center, float peak) { stampPoint(center, peak); });
+    return true;
+}
+
+void HeatMapRenderer::restoreNearestKeyframe(qsizetype end)
+{
+    // 候选为紧邻 end 两侧的关键帧与空密度场，只在比从当前状态增量更新更近时恢复
+    const auto after = std::lower_bound(m_keyframes.cbegin(), m_keyframes.cend(), end,
+                                        [](const Keyframe &keyframe, qsizetype count) { return keyframe.pointCount < count; });
+    qsizetype bestDistance = qAbs(end - m_stampedCount);
+    const Keyframe *best = nullptr;
+    bool restoreEmpty = false;
+    if (end < bestDistance) {
+        bestDistance = end;
+        restoreEmpty = true;
+    }
+    if (after != m_keyframes.cend() && after->pointCount - end < bestDistance) {
+        bestDistance = after->pointCount - end;
+        best = &*after;
+    }
+    if (after != m_keyframes.cbegin() && end - (after - 1)->pointCount < bestDistance)
+        best = &*(after - 1);
+    if (!best && !restoreEmpty)
+        return;
+
+    QVector<float> &target = m_binnedActive ? m_histogram : m_field;
+    if (best)
+        target = best->data; // 隐式共享，之后写入时才复制
+    else
+        target.fill(0.0f);
+    m_stampedCount = best ? best->pointCount : 0;
+    m_mipBuilt = 0;
+    if (m_binnedActive && m_stampedCount == end)
+        blurBinnedDensity();
+    invalidate(ResampleStage);
+}
+
+bool HeatMapRenderer::stampPointsTiled(const HeatMapPointStore &points, qsizetype first, qsizetype last)
+{
+    const int tilesX = (m_fieldSize.width() + kTileSize - 1) / kTileSize;
+    const int tilesY = (m_fieldSize.height() + kTileSize - 1) / kTileSize;
+    const QRect bounds(QPoint(0, 0), m_fieldSize);
+    const int extent = m_stamp.extent();
+
+    // 先在调用线程完成坐标映射，并把每个点分配到其核覆盖的全部瓦片；
+    // 点按序号顺序加入各瓦片，保证每个像素的累加顺序与逐点串行叠加相同
+    resizeBuffer(m_stampCenters, last - first, m_stats);
+    resizeBuffer(m_stampPeaks, last - first, m_stats);
+    resizeBuffer(m_tilePoints, qsizetype(tilesX) * tilesY, m_stats);
+    for (QVector<int> &tile : m_tilePoints)
+        tile.resize(0); // 保留容量
+    forEachStampedPoint(points, first, last, [&](qsizetype index, const QPointF &center, float peak) {
+        m_stampCenters[index - first] = center;
+        m_stampPeaks[index - first] = peak;
+    });
+    for (int i = 0; i < m_stampCenters.size(); ++i) {
+        const int anchorX = qFloor(m_stampCenters[i].x());
+        const int anchorY = qFloor(m_stampCenters[i].y());
+        const QRect covered = QRect(anchorX - extent, anchorY - extent, extent * 2 + 1, extent * 2 + 1) & bounds;
+        if (covered.isEmpty())
+            continue;
+        for (int ty = covered.top() / kTileSize; ty <= covered.bottom() / kTileSize; ++ty) {
+            for (int tx = covered.left() / kTileSize; tx <= covered.right() / kTileSize; ++tx) {
+                QVector<int> &tile = m_tilePoints[ty * tilesX + tx];
+                HEATMAP_STATS(if (tile.size() == tile.capacity()) ++m_stats.allocations);
+                tile.append(i);
+            }
+        }
+    }
+
+    // 瓦片互不重叠，各自只写入自身范围，核印章在此之后只读共享；
+    // 每个瓦片开始前检查取消标志，已取消时剩余瓦片直接跳过
+    m_stamp.buildAllPhases();
+    float *grid = m_field.data();
+    const int stride = m_fieldSize.width();
+    HeatMapKernels::parallelFor(m_pool, m_tilePoints.size(), [&](int tile) {
+        if (cancelled())
+            return;
+        const QRect clip = QRect((tile % tilesX) * kTileSize, (tile / tilesX) * kTileSize, kTileSize, kTileSize) & bounds;
+        for (int i : m_tilePoints.at(tile))
+            m_stamp.stamp(grid, stride, m_stampCenters.at(i), m_stampPeaks.at(i), clip);
+    });
+    return !cancelled();
+}
+
+const float *HeatMapRenderer::mipLevelData(int level, QSize *size) const
+{
+    if (level == 0) {
+        *size = m_fieldSize;
+        return m_field.constData();
+    }
+    const MipLevel &mip = m_mipLevels.at(level - 1);
+    *size = mip.size;
+    return mip.data.constData();
+}
+
+int HeatMapRenderer::mipLevelForDisplay() const
+{
+    // 选取分辨率仍不低于显示区域的最小一级，缩小显示时避免欠采样造成的闪烁
+    const QRectF &placement = m_params.displayRect;
+    if (placement.isEmpty())
+        return 0;
+    qreal ratio = qMin(m_fieldSize.width() / placement.width(), m_fieldSize.height() / placement.height());
+    int level = 0;
+    while (ratio >= 2.0 && level < kMaxMipLevels) {
+        ratio /= 2.0;
+        ++level;
+    }
+    return level;
+}
+
+bool HeatMapRenderer::ensureMipLevels(int level)
+{
+    if (m_mipLevels.size() < level)
+        m_mipLevels.resize(level);
+    for (int k = m_mipBuilt + 1; k <= level; ++k) {
+        if (cancelled())
+            return false;
+        QSize sourceSize;
+        const float *source = mipLevelData(k - 1, &sourceSize);
+        MipLevel &mip = m_mipLevels[k - 1];
+        mip.size = QSize((sourceSize.width() + 1) / 2, (sourceSize.height() + 1) / 2);
+        resizeBuffer(mip.data, static_cast<qsizetype>(mip.size.width()) * mip.size.height(), m_stats);
+        HeatMapKernels::downsample2x(source, sourceSize.width(), sourceSize.height(), mip.data.data(),
+                                     QRect(QPoint(0, 0), mip.size));
+        m_mipBuilt = k;
+    }
+    return true;
+}
+
+void HeatMapRenderer::updateMipRegion(const QRect &fieldRegion)
+{
+    // 逐级把变化区域减半，只重新计算受影响的像素
+    QRect region = fieldRegion;
+    for (int k = 1; k <= m_mipBuilt; ++k) {
+        QSize sourceSize;
+        const float *source = mipLevelData(k - 1, &sourceSize);
+        MipLevel &mip = m_mipLevels[k - 1];
+        region = QRect(QPoint(region.left() / 2, region.top() / 2), QPoint(region.right() / 2, region.bottom() / 2))
+                 & QRect(QPoint(0, 0), mip.size);
+        HeatMapKernels::downsample2x(source, sourceSize.width(), sourceSize.height(), mip.data.data(), region);
+    }
+}
+
+bool HeatMapRenderer::resampleField()
+{
+    // 规范分辨率下按行带并行从合适的 mip 级别重采样，缩放窗口与切换缩放模式只需这一步；
+    // 直接模式下密度场即输出分辨率，只需重新求最大值
+    if (usesCanonicalField()) {
+        m_displayLevel = mipLevelForDisplay();
+        if (!ensureMipLevels(m_displayLevel))
+            return false;
+
+        QSize levelSize;
+        const float *level = mipLevelData(m_displayLevel, &levelSize);
+        float *density = m_density.data();
+        const QSize size = m_params.size;
+        const int bands = (size.height() + kTileSize - 1) / kTileSize;
+        HeatMapKernels::prepareBilinearColumns(levelSize.width(), m_params.displayRect, 0, size.width(),
+                                               m_resampleColumns);
+        HeatMapKernels::parallelFor(bands > 1 ? m_pool : nullptr, bands, [&](int band) {
+            if (cancelled())
+                return;
+            const QRect rows(0, band * kTileSize, size.width(), qMin(kTileSize, size.height() - band * kTileSize));
+            HeatMapKernels::resampleBilinear(level, levelSize.width(), levelSize.height(), m_params.displayRect,
+                                             m_resampleColumns, density, size.width(), rows);
+        });
+        if (cancelled())
+            return false;
+        HEATMAP_STATS(m_stats.pixelsTouched += qsizetype(size.width()) * size.height());
+    }
+
+    // 最大密度属于重采样阶段的产物，归一化方式切换时无需重新扫描
+    m_maxDensity = scanMaxDensity();
+    return true;
+}
+
+QRect HeatMapRenderer::resampleFieldRegion(const QRect &fieldRegion)
+{
+    const QRectF &placement = m_params.displayRect;
+    const qreal scaleX = placement.width() / m_fieldSize.width();
+    const qreal scaleY = placement.height() / m_fieldSize.height();
+    // mip 平均与双线性插值会把变化向外扩散约一个级别像素
+    const qreal margin = (1 << m_displayLevel) * qMax(scaleX, scaleY) + 1.0;
+    const QRectF mapped(placement.left() + fieldRegion.left() * scaleX, placement.top() + fieldRegion.top() * scaleY,
+                        fieldRegion.width() * scaleX, fieldRegion.height() * scaleY);
+    const QRect region = mapped.adjusted(-margin, -margin, margin, margin).toAlignedRect()
+                         & QRect(QPoint(0, 0), m_params.size);
+
+    QSize levelSize;
+    const float *level = mipLevelData(m_displayLevel, &levelSize);
+    HeatMapKernels::prepareBilinearColumns(levelSize.width(), placement, region.left(), region.width(),
+                                           m_resampleColumns);
+    HeatMapKernels::resampleBilinear(level, levelSize.width(), levelSize.height(), placement, m_resampleColumns,
+                                     m_density.data(), m_params.size.width(), region);
+    HEATMAP_STATS(m_stats.pixelsTouched += qsizetype(region.width()) * region.height());
+    return region;
+}
+
+float HeatMapRenderer::tileMax(int tile, quint32 *histogram) const
+{
+    const int tilesX = (m_image.width() + kTileSize - 1) / kTileSize;
+    const QRect rect = QRect((tile % tilesX) * kTileSize, (tile / tilesX) * kTileSize, kTileSize, kTileSize)
+                       & m_image.rect();
+    const float *density = displayDensity();
+    const int stride = m_image.width();
+    float result = 0.0f;
+    if (histogram)
+        std::fill_n(histogram, HeatMapKernels::kIntensityBins, 0u);
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const float *row = density + static_cast<qsizetype>(y) * stride + rect.left();
+        result = qMax(result, HeatMapKernels::maxValue(row, rect.width()));
+        if (histogram)
+            HeatMapKernels::accumulateIntensityHistogram(row, rect.width(), histogram);
+    }
+    return result;
+}
+
+float HeatMapRenderer::scanMaxDensity()
+{
+    // 按瓦片并行求局部最大值并保留，最后归约为全局最大值；
+    // 分位数归一化时顺带统计各瓦片的强度直方图
+    const int tilesX = (m_image.width() + kTileSize - 1) / kTileSize;
+    const int tilesY = (m_image.height() + kTileSize - 1) / kTileSize;
+    const bool histograms = usesPercentile();
+    m_tileMax.resize(tilesX * tilesY);
+    if (histograms)
+        resizeBuffer(m_tileHistograms, m_tileMax.size() * HeatMapKernels::kIntensityBins, m_stats);
+    float *tileResults = m_tileMax.data();
+    quint32 *tileHistograms = histograms ? m_tileHistograms.data() : nullptr;
+    HeatMapKernels::parallelFor(m_tileMax.size() > 1 ? m_pool : nullptr, m_tileMax.size(), [&](int tile) {
+        tileResults[tile] = tileMax(tile, tileHistograms ? tileHistograms + tile * HeatMapKernels::kIntensityBins
+                                                         : nullptr);
+    });
+
+    m_intensityHistogramValid = false;
+    if (histograms) {
+        m_intensityHistogram.fill(0u, HeatMapKernels::kIntensityBins);
+        const quint32 *tile = m_tileHistograms.constData();
+        for (qsizetype i = 0; i < m_tileMax.size(); ++i, tile += HeatMapKernels::kIntensityBins) {
+            for (int bin = 0; bin < HeatMapKernels::kIntensityBins; ++bin)
+                m_intensityHistogram[bin] += tile[bin];
+        }
+        m_intensityCount = 0;
+        for (quint32 count : std::as_const(m_intensityHistogram))
+            m_intensityCount += count;
+        m_intensityHistogramValid = true;
+    }
+
+    float result = 0.0f;
+    for (float value : std::as_const(m_tileMax))
+        result = qMax(result, value);
+    return result;
+}
+
+QVector<HeatMapHotspot> HeatMapRenderer::findHotspots(int count, qreal minDistance) const
+{
+    if (count <= 0 || m_image.isNull())
+        return {};
+
+    const int width = m_image.width();
+    const int height = m_image.height();
+    const int tilesX = (width + kTileSize - 1) / kTileSize;
+    const int tilesY = (height + kTileSize - 1) / kTileSize;
+    const bool tileMaxValid = m_tileMax.size() == tilesX * tilesY;
+    const float *density = displayDensity();
+    auto valueAt = [=](int x, int y) {
+        return (x < 0 || y < 0 || x >= width || y >= height) ? 0.0f : density[static_cast<qsizetype>(y) * width + x];
+    };
+
+    // 局部极大值：不小于 8 邻域，且严格大于扫描顺序在前的 4 个邻域，平台区域只取一个像素
+    QVector<QVector<HeatMapHotspot>> tilePeaks(tilesX * tilesY);
+    HeatMapKernels::parallelFor(tilePeaks.size() > 1 ? m_pool : nullptr, tilePeaks.size(), [&](int tile) {
+        if (tileMaxValid && !(m_tileMax.at(tile) > 0.0f))
+            return;
+        const QRect rect = QRect((tile % tilesX) * kTileSize, (tile / tilesX) * kTileSize, kTileSize, kTileSize)
+                           & m_image.rect();
+        QVector<HeatMapHotspot> &peaks = tilePeaks[tile];
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const float value = density[static_cast<qsizetype>(y) * width + x];
+                if (!(value > 0.0f))
+                    continue;
+                if (value <= valueAt(x - 1, y - 1) || value <= valueAt(x, y - 1) || value <= valueAt(x + 1, y - 1)
+                    || value <= valueAt(x - 1, y) || value < valueAt(x + 1, y) || value < valueAt(x - 1, y + 1)
+                    || value < valueAt(x, y + 1) || value < valueAt(x + 1, y + 1))
+                    continue;
+                peaks.append({QPointF(x + 0.5, y + 0.5), value});
+            }
+        }
+    });
+
+    QVector<HeatMapHotspot> candidates;
+    for (const QVector<HeatMapHotspot> &peaks : std::as_const(tilePeaks))
+        candidates.append(peaks);
+    // 密度相同时按位置排序，结果与线程数无关
+    std::sort(candidates.begin(), candidates.end(), [](const HeatMapHotspot &a, const HeatMapHotspot &b) {
+        if (a.density != b.density)
+            return a.density > b.density;
+        if (a.position.y() != b.position.y())
+            return a.position.y() < b.position.y();
+        return a.position.x() < b.position.x();
+    });
+
+    // 非极大值抑制：从强到弱，与已选热点距离不足 minDistance 的丢弃
+    const qreal minDistance2 = minDistance * minDistance;
+    QVector<HeatMapHotspot> result;
+    for (const HeatMapHotspot &candidate : std::as_const(candidates)) {
+        const bool suppressed = std::any_of(result.cbegin(), result.cend(), [&](const HeatMapHotspot &kept) {
+            const QPointF offset = kept.position - candidate.position;
+            return offset.x() * offset.x() + offset.y() * offset.y() < minDistance2;
+        });
+        if (suppressed)
+            continue;
+        result.append(candidate);
+        if (result.size() >= count)
+            break;
+    }
+    return result;
+}
+
+void HeatMapRenderer::updateTileMax(const QRect &region)
+{
+    // 扣除过期点可能让最大值下降，只重扫与变化区域相交的瓦片，全局最大值取自瓦片记录；
+    // 维护直方图时先减去这些瓦片的旧贡献，重扫后再加上新贡献
+    const int tilesX = (m_image.width() + kTileSize - 1) / kTileSize;
+    for (int ty = region.top() / kTileSize; ty <= region.bottom() / kTileSize; ++ty) {
+        for (int tx = region.left() / kTileSize; tx <= region.right() / kTileSize; ++tx) {
+            const int tile = ty * tilesX + tx;
+            if (!m_intensityHistogramValid) {
+                m_tileMax[tile] = tileMax(tile);
+                continue;
+            }
+            quint32 *histogram = m_tileHistograms.data() + tile * HeatMapKernels::kIntensityBins;
+            for (int bin = 0; bin < HeatMapKernels::kIntensityBins; ++bin) {
+                m_intensityHistogram[bin] -= histogram[bin];
+                m_intensityCount -= histogram[bin];
+            }
+            m_tileMax[tile] = tileMax(tile, histogram);
+            for (int bin = 0; bin < HeatMapKernels::kIntensityBins; ++bin) {
+                m_intensityHistogram[bin] += histogram[bin];
+                m_intensityCount += histogram[bin];
+            }
+        }
+    }
+
+    m_maxDensity = 0.0f;
+    for (float value : std::as_const(m_tileMax))
+        m_maxDensity = qMax(m_maxDensity, value);
+}
+
+bool HeatMapRenderer::usesPercentile() const
+{
+    return m_params.autoNormalize && m_params.normalization == HeatMapRenderParams::Normalization::Percentile;
+}
+
+void HeatMapRenderer::rebuildIntensityHistogram()
+{
+    // 切换到分位数归一化时，输出密度未变，只补建直方图（顺带刷新瓦片最大值）
+    m_maxDensity = scanMaxDensity();
+}
+
+float HeatMapRenderer::percentileDensity() const
+{
+    // 从高到低累计直到超出分位数之外的像素数，取所在分箱的上界并以最大值为上限；
+    // 分箱为 1/16 倍频程，参考密度只在分位数跨越分箱边界时变化，增量叠加多数时候只需局部着色
+    if (m_intensityCount == 0)
+        return 0.0f;
+    const qreal percentile = qBound<qreal>(0.0, m_params.normalizePercentile, 1.0);
+    const quint64 above = static_cast<quint64>((1.0 - percentile) * m_intensityCount);
+    quint64 counted = 0;
+    for (int bin = HeatMapKernels::kIntensityBins - 1; bin >= 0; --bin) {
+        counted += m_intensityHistogram.at(bin);
+        if (counted > above)
+            return qMin(m_maxDensity, HeatMapKernels::intensityBinLowerBound(bin + 1));
+    }
+    return m_maxDensity;
+}
+
+void HeatMapRenderer::updatePointsIncrementally(const HeatMapPointStore &points)
+{
+    // 增量更新：新增点叠加、滑出窗口的点扣除，只在受影响的包围盒内重新重采样、归一化与着色，
+    // 开销与进出窗口的点数成正比，与历史总点数无关。回放向后跳转时（仅累计模式），
+    // 回放位置之后已叠加的点同样扣除
+    const qsizetype begin = windowBegin(m_params, points, m_windowBegin);
+    const qsizetype end = pointEnd(m_params, points);
+    const qsizetype removeEnd = qMin(begin, m_stampedCount);
+    const qsizetype addBegin = qMax(begin, m_stampedCount);
+    const qsizetype backBegin = qMax(begin, end);
+    const bool fieldEmptied = begin >= end;
+    const bool removed = removeEnd > m_windowBegin || backBegin < m_stampedCount;
+    HEATMAP_STATS(m_stats.pointsStamped += qMax<qsizetype>(0, removeEnd - m_windowBegin)
+                                           + qMax<qsizetype>(0, m_stampedCount - backBegin)
+                                           + qMax<qsizetype>(0, end - addBegin));
+
+    if (m_binnedActive) {
+        // 分箱模式：进出的点只需在直方图上加减，随后重新模糊整幅密度场
+        forEachStampedPoint(points, m_windowBegin, removeEnd,
+                            [this](qsizetype, const QPointF &center, float peak) { binPoint(center, -peak); });
+        forEachStampedPoint(points, backBegin, m_stampedCount,
+                            [this](qsizetype, const QPointF &center, float peak) { binPoint(center, -peak); });
+        forEachStampedPoint(points, addBegin, end,
+                            [this](qsizetype, const QPointF &center, float peak) { binPoint(center, peak); });
+        if (fieldEmptied)
+            m_histogram.fill(0.0f);
+        else if (removed)
+            std::replace_if(m_histogram.begin(), m_histogram.end(), [](float value) { return value < 0.0f; }, 0.0f);
+        m_windowBegin = begin;
+        m_stampedCount = end;
+        blurBinnedDensity();
+        m_mipBuilt = 0;
+        invalidate(ResampleStage);
+        return;
+    }
+
+    QRect region;
+    forEachStampedPoint(points, m_windowBegin, removeEnd, [&](qsizetype, const QPointF &center, float peak) {
+        region |= stampPoint(center, -peak);
+    });
+    forEachStampedPoint(points, backBegin, m_stampedCount, [&](qsizetype, const QPointF &center, float peak) {
+        region |= stampPoint(center, -peak);
+    });
+    if (fieldEmptied && removed) {
+        // 窗口内已无点：直接清零，避免加减残差在自动归一化下被放大
+        for (int y = region.top(); y <= region.bottom(); ++y)
+            std::fill_n(m_field.data() + static_cast<qsizetype>(y) * m_fieldSize.width() + region.left(),
+                        region.width(), 0.0f);
+    } else {
+        // 浮点加减不能精确抵消，只把扣除区域内的负残差截断为 0，保证着色内核的非负前提；
+        // 正值可能是仍在窗口内的点的核尾部，保留以与整幅重算一致
+        for (int y = region.top(); y <= region.bottom(); ++y) {
+            float *row = m_field.data() + static_cast<qsizetype>(y) * m_fieldSize.width() + region.left();
+            std::replace_if(row, row + region.width(), [](float value) { return value < 0.0f; }, 0.0f);
+        }
+    }
+    forEachStampedPoint(points, addBegin, end, [&](qsizetype, const QPointF &center, float peak) {
+        region |= stampPoint(center, peak);
+    });
+    m_windowBegin = begin;
+    m_stampedCount = end;
+
+    if (region.isEmpty())
+        return;
+
+    if (usesCanonicalField())
+        updateMipRegion(region);
+    // 整图重采样已排期时由其统一处理
+    if (m_dirtyStages & ResampleStage)
+        return;
+    if (usesCanonicalField())
+        region = resampleFieldRegion(region);
+    updateTileMax(region);
+
+    // 整图着色已排期时无需局部着色
+    if (m_dirtyStages & ColorizeStage)
+        return;
+
+    // 归一化系数变化时需要整图重新着色，否则只着色变化区域；
+    // 局部着色被取消时退回整图着色
+    const float previousScale = m_normalizeScale;
+    updateNormalization();
+    if (m_normalizeScale != previousScale || !colorize(region))
+        invalidate(ColorizeStage);
+}
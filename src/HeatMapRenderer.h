@@ -0,0 +1,319 @@
+#pragma once
+
+#include <QBrush>
+#include <QColor>
+#include <QImage>
+#include <QPointF>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+
+#include <atomic>
+#include <cmath>
+
+#include "HeatMapFrameStats.h"
+#include "HeatMapKernels.h"
+#include "HeatMapPointStore.h"
+
+class QThreadPool;
+
+// 渲染一帧热力图所需的全部参数快照，与控件无关，可在任意线程使用
+struct HeatMapRenderParams
+{
+    // 密度计算方式
+    enum class DensityMethod {
+        Automatic, // 点数达到 binningThreshold 时分箱模糊，否则逐点叠加
+        Stamped,
+        Binned
+    };
+
+    // 随时间变化的统计方式
+    enum class TimeMode {
+        AllTime,         // 累计全部历史
+        SlidingWindow,   // 只统计时间戳不早于 windowStart 的点，过期点增量扣除
+        ExponentialDecay // 每个点的强度按 decayHalfLife 指数衰减
+    };
+
+    QSize size;                       // 输出尺寸（像素）
+    QRectF displayRect;               // 背景在输出中的区域，已考虑缩放模式与 letterbox
+    QSize baseImageSize;              // 背景原始尺寸，无背景时为空
+    // 密度场的规范分辨率：非空时密度场覆盖整幅背景并以该分辨率计算，与输出尺寸、
+    // 缩放模式无关，显示时从其 mip 金字塔重采样到 displayRect；为空时直接按输出分辨率计算。
+    // 仅在有背景且半径随背景缩放时适用
+    QSize canonicalSize;
+    bool normalizedCoordinates = true;
+    qreal radius = 25;                // 有效半径（像素），canonicalSize 非空时按规范分辨率计
+    HeatMapKernels::Falloff falloff = HeatMapKernels::Falloff::Linear;
+    DensityMethod densityMethod = DensityMethod::Automatic;
+    int binningThreshold = 200000;
+    bool autoNormalize = true;
+
+    // 自动归一化时映射为满强度的参考密度
+    enum class Normalization {
+        Maximum,   // 最大密度
+        Percentile // 非零像素密度的 normalizePercentile 分位数，更高的密度截断为最热颜色
+    };
+
+    // 归一化强度 t（0~1）到色带位置的映射，烘焙进调色板，不增加逐像素开销
+    enum class IntensityCurve {
+        Linear,      // t
+        Logarithmic, // log(1 + k·t) / log(1 + k)，拉开低强度区域的层次
+        Gamma        // t^intensityGamma
+    };
+
+    Normalization normalization = Normalization::Maximum;
+    qreal normalizePercentile = 0.99;
+    IntensityCurve intensityCurve = IntensityCurve::Linear;
+    qreal intensityGamma = 0.5;
+    TimeMode timeMode = TimeMode::AllTime;
+    qint64 now = 0;                   // 当前时间（毫秒，与点的时间戳同一纪元）
+    qint64 windowStart = 0;           // 滑动窗口的起点
+    qint64 decayHalfLife = 10000;     // 指数衰减的半衰期（毫秒）
+    // 回放：只统计时间戳不晚于 now 的点，now 可前后跳转。累计模式下按点数保存密度关键帧，
+    // 向后跳转从最近的关键帧恢复；其他时间模式向后跳转时重新累积
+    bool clipToNow = false;
+    // 回放关键帧的内存上限（字节），0 表示自动：至多 8 个密度场且不超过 32MB
+    qsizetype keyframeBudget = 0;
+    QColor coldColor = QColor(0, 120, 255);
+    QColor hotColor = QColor(255, 0, 0);
+    QGradientStops colorStops;
+};
+
+// 一帧内固定的点坐标映射。坐标模式、背景尺寸与 displayRect 在一帧内不变，
+// mapToDisplay() 的各分支可预先化简为逐轴仿射变换，逐点映射不再判断设置
+struct HeatMapPointMapping
+{
+    qreal scaleX = 1.0;
+    qreal scaleY = 1.0;
+    qreal offsetX = 0.0;
+    qreal offsetY = 0.0;
+
+    QPointF map(const QPointF &pos) const { return QPointF(pos.x() * scaleX + offsetX, pos.y() * scaleY + offsetY); }
+};
+
+// 密度场中的一个热点：输出像素坐标与该处的密度（单位同 HeatMapRenderer::maxDensity()）
+struct HeatMapHotspot
+{
+    QPointF position;
+    float density = 0.0f;
+};
+
+// 热力图渲染管线：密度累积 → 归一化 → 查表着色，输出预乘 ARGB 图像。
+// 不依赖控件，持有跨帧复用的缓冲，可整体交给工作线程执行。
+// 两次 render() 之间点列表只能在末尾追加，否则须先使 DensityStage 失效；
+// 时间戳须单调不减，滑动窗口与回放据此二分查找过期点与可见点的范围。
+class HeatMapRenderer
+{
+public:
+    using HeatPoint = HeatMapPoint;
+
+    // 渲染管线的各阶段，按位组合表示需要重跑的阶段；
+    // 上游阶段失效会连带其全部下游阶段。几何阶段只在密度场本身受影响
+    // （半径、形状、坐标映射或直接模式下的输出尺寸变化）时才连带密度阶段
+    enum Stage : uint {
+        GeometryStage = 0x1,  // 缓冲尺寸、坐标映射、有效半径与核印章
+        DensityStage = 0x2,   // 密度场累积（逐点叠加或分箱模糊）
+        ResampleStage = 0x4,  // 密度场重采样到输出分辨率及最大密度
+        NormalizeStage = 0x8, // 归一化系数
+        ColorizeStage = 0x10, // 调色板查表着色
+        AllStages = 0x1f
+    };
+
+    // 点击坐标到输出像素坐标的映射：归一化坐标相对 displayRect，
+    // 否则视为背景原始分辨率坐标并按缩放比例映射
+    static QPointF mapToDisplay(const HeatMapRenderParams &params, const QPointF &pos);
+    static HeatMapPointMapping displayMapping(const HeatMapRenderParams &params);
+    // 参与渲染的点的末尾下标：回放时为时间戳晚于 now 的第一个点，否则为全部点
+    static qsizetype pointEnd(const HeatMapRenderParams &params, const HeatMapPointStore &points);
+    // mapToDisplay() 的逆映射
+    static QPointF mapFromDisplay(const HeatMapRenderParams &params, const QPointF &pos);
+    // 输出像素下的有效半径：规范分辨率下 params.radius 按规范分辨率计，换算到 displayRect
+    static qreal displayRadius(const HeatMapRenderParams &params);
+    // 点叠加到密度场时的峰值：180 * weight，衰减模式下再乘以相对 decayOrigin 的增益
+    static float pointPeak(const HeatMapRenderParams &params, const HeatPoint &point, qint64 decayOrigin);
+
+    // 按时间模式特化的峰值函数。逐点循环在循环外调用一次 withPeakFunction()，
+    // 以对应的函数对象实例化循环体，循环内不再判断时间模式
+    struct ConstantPeak
+    {
+        float operator()(const HeatPoint &point) const { return static_cast<float>(180 * point.weight); }
+    };
+    struct DecayPeak
+    {
+        qint64 origin = 0;
+        qreal halfLife = 1.0;
+        float operator()(const HeatPoint &point) const
+        {
+            return static_cast<float>(180 * point.weight) * static_cast<float>(std::exp2((point.timestamp - origin) / halfLife));
+        }
+    };
+    template <typename Fn>
+    static void withPeakFunction(const HeatMapRenderParams &params, qint64 decayOrigin, Fn &&fn)
+    {
+        if (params.timeMode == HeatMapRenderParams::TimeMode::ExponentialDecay)
+            fn(DecayPeak{decayOrigin, static_cast<qreal>(qMax<qint64>(1, params.decayHalfLife))});
+        else
+            fn(ConstantPeak{});
+    }
+
+    // 并行瓦片渲染使用的线程池，为空时单线程执行
+    void setThreadPool(QThreadPool *pool) { m_pool = pool; }
+
+    void invalidate(uint stages);
+    // 输出是否已与给定参数及点数一致
+    bool isUpToDate(const HeatMapRenderParams &params, const HeatMapPointStore &points) const;
+    // 剩余工作是否只是开销 O(radius²) 的逐点增量叠加或扣除，可直接在 GUI 线程完成
+    bool hasOnlyIncrementalWork(const HeatMapRenderParams &params, const HeatMapPointStore &points) const;
+
+    // 把输出更新到与 params、points 一致，只重跑失效的阶段。
+    // cancel 被置位时尽快返回 false，未完成的阶段保持失效，下次调用会重新执行
+    bool render(const HeatMapRenderParams &params, const HeatMapPointStore &points,
+                const std::atomic<bool> *cancel = nullptr);
+
+    const QImage &image() const { return m_image; }
+    float maxDensity() const { return m_maxDensity; }
+    // 当前输出所用的归一化系数、调色板与衰减时间基准，HeatMapTileCache 据此按相同方式着色
+    float normalizeScale() const { return m_normalizeScale; }
+    const QVector<QRgb> &palette() const { return m_palette; }
+    qint64 decayOrigin() const { return m_decayOrigin; }
+    // 最近一次 render() 的统计，未启用 HEATMAP_INSTRUMENTATION 时始终为零
+    const HeatMapFrameStats &stats() const { return m_stats; }
+
+    // 当前输出密度中最强的至多 count 个局部极大值，按密度降序；彼此距离小于 minDistance
+    // （输出像素）的极大值只保留较强者（非极大值抑制）。各瓦片并行查找，跳过最大值为 0 的瓦片
+    QVector<HeatMapHotspot> findHotspots(int count, qreal minDistance) const;
+
+private:
+    bool usesBinning(const HeatMapRenderParams &params, qsizetype pointCount) const;
+    bool usesCanonicalField() const { return !m_params.canonicalSize.isEmpty(); }
+    // 滑动窗口内第一个点的下标，from 之前的点视为已过期
+    static qsizetype windowBegin(const HeatMapRenderParams &params, const HeatMapPointStore &points,
+                                 qsizetype from);
+    bool normalizationOutdated(const HeatMapRenderParams &params) const;
+    float decayFactor() const;
+    void rebaseDecay();
+    bool cancelled() const { return m_cancel && m_cancel->load(std::memory_order_relaxed); }
+    HeatMapPointMapping fieldMapping() const;
+    // 以当前参数的映射与特化的峰值函数遍历 [first, last) 的点：fn(下标, 密度场坐标, 峰值)
+    template <typename Fn>
+    void forEachStampedPoint(const HeatMapPointStore &points, qsizetype first, qsizetype last, Fn &&fn) const;
+    // 输出分辨率的密度：直接模式下即密度场本身
+    const float *displayDensity() const { return usesCanonicalField() ? m_density.constData() : m_field.constData(); }
+
+    bool updateGeometry();
+    bool accumulateDensity(const HeatMapPointStore &points);
+    void prepareImageForWrite(bool preserveContents);
+    bool stampPoints(const HeatMapPointStore &points, qsizetype first, qsizetype last);
+    bool stampPointsTiled(const HeatMapPointStore &points, qsizetype first, qsizetype last);
+    bool usesKeyframes() const;
+    void restoreNearestKeyframe(qsizetype end);
+    void updatePointsIncrementally(const HeatMapPointStore &points);
+    QRect stampPoint(const QPointF &center, float peak);
+    void binPoint(const QPointF &center, float peak);
+    void blurBinnedDensity();
+    bool resampleField();
+    QRect resampleFieldRegion(const QRect &fieldRegion);
+    int mipLevelForDisplay() const;
+    bool ensureMipLevels(int level);
+    void updateMipRegion(const QRect &fieldRegion);
+    const float *mipLevelData(int level, QSize *size) const;
+    float scanMaxDensity();
+    float tileMax(int tile, quint32 *histogram = nullptr) const;
+    void updateTileMax(const QRect &region);
+    bool usesPercentile() const;
+    void rebuildIntensityHistogram();
+    float percentileDensity() const;
+    void updateNormalization();
+    bool colorize(const QRect &region);
+    void rebuildPalette();
+
+    HeatMapRenderParams m_params;
+    HeatMapPointMapping m_fieldMapping; // 点坐标到密度场坐标，每次 render() 开始时按参数计算
+    QThreadPool *m_pool = nullptr;
+    const std::atomic<bool> *m_cancel = nullptr;
+    uint m_dirtyStages = AllStages;
+    HeatMapFrameStats m_stats;
+
+    // 密度场是热力强度的唯一数据源（float 累加，不在 255 处饱和）。规范分辨率下
+    // 密度场与输出尺寸无关，缩放窗口或切换缩放模式只需重采样到 m_density；
+    // 归一化与着色均读取输出分辨率的密度并写入 8 位 ARGB 图像
+    QVector<float> m_field;
+    QSize m_fieldSize;
+    HeatMapRenderParams m_fieldParams; // 构建当前密度场时的参数，用于判断密度场是否失效
+    QVector<float> m_density;     // 重采样后的输出分辨率密度，直接模式下为空
+
+    // 密度场的 mip 金字塔（第 1 级起，第 0 级即 m_field），按显示所需的级别懒生成
+    struct MipLevel
+    {
+        QVector<float> data;
+        QSize size;
+    };
+    static constexpr int kMaxMipLevels = 8;
+    QVector<MipLevel> m_mipLevels;
+    int m_mipBuilt = 0;           // 与当前密度场一致的级数（不含第 0 级）
+    int m_displayLevel = 0;       // 当前输出重采样所用的级别
+    HeatMapKernels::BilinearColumns m_resampleColumns;
+
+    // 归一化并着色后的热力图。上一帧被调用方共享时（如控件在后台渲染期间显示旧帧）
+    // 改写 m_spareImage 并与之交换，两块缓冲在尺寸不变时轮流使用，不再逐帧分配
+    QImage m_image;
+    QImage m_spareImage;
+    qsizetype m_stampedCount = 0; // 已处理的点数，新增点击只需增量叠加
+    qsizetype m_windowBegin = 0;  // 密度场中第一个点的下标，之前的点已过期并扣除
+    qint64 m_decayOrigin = 0;     // 衰减模式下密度场的时间基准，点按相对它的增益叠加
+    qint64 m_normalizedNow = 0;   // 计算归一化系数时的时间
+    float m_maxDensity = 0.0f;    // 输出分辨率密度中的最大值
+    // 输出按 kTileSize 瓦片记录局部最大值，扣除过期点后只需重扫受影响的瓦片
+    QVector<float> m_tileMax;
+    // 分位数归一化时每个瓦片另记强度直方图，全局直方图为其和：局部变化只需重扫受影响的瓦片
+    // 并增减其贡献，分位数查询与像素数无关。其他归一化方式下不维护
+    QVector<quint32> m_tileHistograms; // 瓦片数 × HeatMapKernels::kIntensityBins
+    QVector<quint32> m_intensityHistogram;
+    quint64 m_intensityCount = 0;      // 直方图中的非零像素数
+    bool m_intensityHistogramValid = false;
+    float m_normalizeScale = 1.0f / 255.0f; // 密度到 0~1 强度的缩放系数
+    HeatMapKernels::KernelStamp m_stamp;    // 按有效半径缓存的核印章
+
+    // 回放关键帧：累计模式下每 m_keyframeInterval 个点保存一次密度场（分箱模式为直方图）快照，
+    // 在重新累积时一次生成。跳转时若某个关键帧比当前状态更接近目标，先恢复该关键帧，
+    // 再增量叠加或扣除其间的点，每次跳转最多处理约半个间隔的点
+    struct Keyframe
+    {
+        qsizetype pointCount = 0;
+        QVector<float> data;
+    };
+    QVector<Keyframe> m_keyframes;
+    qsizetype m_keyframeInterval = 0;
+    static constexpr int kMaxKeyframes = 32;
+    static constexpr int kDefaultKeyframes = 8;
+    static constexpr qsizetype kDefaultKeyframeBudgetBytes = qsizetype(32) << 20;
+    static constexpr qsizetype kMinKeyframeInterval = 1024;
+
+    // 分箱模式：m_histogram 为按密度场分辨率累积的点质量，模糊后写入 m_field
+    QVector<float> m_histogram;
+    HeatMapKernels::BlurScratch m_blurScratch;
+    bool m_binnedActive = false;  // 当前密度场是否由分箱模糊生成
+
+    // 并行渲染：输出按 kTileSize 划分瓦片，叠加、最大值归约与着色在线程池上并行，
+    // 每个像素的累加顺序与单线程一致，结果逐位相同
+    static constexpr int kTileSize = 128;
+    static constexpr int kParallelPointThreshold = 64; // 点数较少时并行调度得不偿失
+    // stampPointsTiled() 的工作缓冲：映射后的点中心与峰值、各瓦片的点序号，只增不减，跨帧复用
+    QVector<QPointF> m_stampCenters;
+    QVector<float> m_stampPeaks;
+    QVector<QVector<int>> m_tilePoints;
+    static constexpr int kIncrementalPointLimit = 256;  // 超过该数量的新增点交给后台任务叠加
+    // 衰减模式下距时间基准超过该半衰期数时整体缩放密度场并重置基准，避免增益溢出
+    static constexpr int kDecayRebaseHalfLives = 16;
+
+    // 预乘 ARGB 调色板：归一化强度 0~1 映射到 kPaletteSize 级，着色时逐像素查表；
+    // 记录构建时的颜色与强度曲线，未变时着色阶段不会重建
+    static constexpr int kPaletteSize = 1024;
+    static constexpr qreal kLogCurveGain = 1000.0; // 对数曲线的 k，强度 0.001 约映射到色带的 10%
+    QVector<QRgb> m_palette;
+    QColor m_paletteCold;
+    QColor m_paletteHot;
+    QGradientStops m_paletteStops;
+    HeatMapRenderParams::IntensityCurve m_paletteCurve = HeatMapRenderParams::IntensityCurve::Linear;
+    qreal m_paletteGamma = 0;
+};
@@ -0,0 +1,157 @@
+#include "HeatMapSpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+void HeatMapSpatialIndex::setBounds(const QRectF &bounds)
+{
+    if (!m_automaticBounds && bounds == m_bounds)
+        return;
+    m_automaticBounds = false;
+    m_bounds = bounds;
+    clear();
+}
+
+void HeatMapSpatialIndex::setAutomaticBounds()
+{
+    if (m_automaticBounds)
+        return;
+    m_automaticBounds = true;
+    clear();
+}
+
+void HeatMapSpatialIndex::clear()
+{
+    m_cells.clear();
+    m_indexedCount = 0;
+    if (m_automaticBounds)
+        m_bounds = QRectF();
+}
+
+void HeatMapSpatialIndex::growBounds(const HeatMapPointStore &points)
+{
+    if (m_indexedCount >= points.size())
+        return;
+    // 未索引点的包围盒
+    qreal left = std::numeric_limits<qreal>::max();
+    qreal top = std::numeric_limits<qreal>::max();
+    qreal right = std::numeric_limits<qreal>::lowest();
+    qreal bottom = std::numeric_limits<qreal>::lowest();
+    HeatMapPoint chunk[HeatMapPointStore::kDecodeChunk];
+    for (qsizetype begin = m_indexedCount; begin < points.size(); begin += HeatMapPointStore::kDecodeChunk) {
+        const qsizetype count = qMin(HeatMapPointStore::kDecodeChunk, points.size() - begin);
+        points.decode(begin, count, chunk);
+        for (qsizetype i = 0; i < count; ++i) {
+            left = qMin(left, chunk[i].pos.x());
+            top = qMin(top, chunk[i].pos.y());
+            right = qMax(right, chunk[i].pos.x());
+            bottom = qMax(bottom, chunk[i].pos.y());
+        }
+    }
+    const bool hasBounds = m_bounds.width() > 0 && m_bounds.height() > 0;
+    if (hasBounds && left >= m_bounds.left() && top >= m_bounds.top() && right <= m_bounds.right()
+        && bottom <= m_bounds.bottom())
+        return;
+
+    // 合并已有范围后向四周各延伸一半（至少 1），之后的点多半仍落在范围内
+    if (hasBounds) {
+        left = qMin(left, m_bounds.left());
+        top = qMin(top, m_bounds.top());
+        right = qMax(right, m_bounds.right());
+        bottom = qMax(bottom, m_bounds.bottom());
+    }
+    const qreal marginX = qMax<qreal>((right - left) / 2, 1);
+    const qreal marginY = qMax<qreal>((bottom - top) / 2, 1);
+    m_bounds = QRectF(QPointF(left - marginX, top - marginY), QPointF(right + marginX, bottom + marginY));
+    m_cells.clear();
+    m_indexedCount = 0;
+}
+
+QPoint HeatMapSpatialIndex::cellOf(const QPointF &pos) const
+{
+    const qreal x = m_bounds.width() > 0 ? (pos.x() - m_bounds.left()) / m_bounds.width() * kGridSize : 0.0;
+    const qreal y = m_bounds.height() > 0 ? (pos.y() - m_bounds.top()) / m_bounds.height() * kGridSize : 0.0;
+    // 先在浮点域截断，避免极端坐标转换为 int 时溢出
+    return QPoint(static_cast<int>(std::clamp<qreal>(std::floor(x), 0, kGridSize - 1)),
+                  static_cast<int>(std::clamp<qreal>(std::floor(y), 0, kGridSize - 1)));
+}
+
+void HeatMapSpatialIndex::update(const HeatMapPointStore &points)
+{
+    if (points.size() < m_indexedCount)
+        clear();
+    if (m_automaticBounds)
+        growBounds(points);
+    if (m_cells.isEmpty())
+        m_cells.resize(kGridSize * kGridSize);
+
+    HeatMapPoint chunk[HeatMapPointStore::kDecodeChunk];
+    for (qsizetype begin = m_indexedCount; begin < points.size(); begin += HeatMapPointStore::kDecodeChunk) {
+        const qsizetype count = qMin(HeatMapPointStore::kDecodeChunk, points.size() - begin);
+        points.decode(begin, count, chunk);
+        for (qsizetype i = 0; i < count; ++i) {
+            const QPoint cell = cellOf(chunk[i].pos);
+            m_cells[cell.y() * kGridSize + cell.x()].append(static_cast<quint32>(begin + i));
+        }
+    }
+    m_indexedCount = points.size();
+}
+
+void HeatMapSpatialIndex::candidates(const QRectF &rect, qsizetype first, qsizetype last,
+                                     QVector<quint32> &out) const
+{
+    out.clear();
+    if (m_cells.isEmpty() || first >= last)
+        return;
+    const QPoint topLeft = cellOf(rect.topLeft());
+    const QPoint bottomRight = cellOf(rect.bottomRight());
+    // 每格内下标 [first, last) 的范围
+    auto range = [&](int cx, int cy) {
+        const QVector<quint32> &cell = m_cells.at(cy * kGridSize + cx);
+        const auto begin = std::lower_bound(cell.cbegin(), cell.cend(), static_cast<quint32>(first));
+        const auto end = last < m_indexedCount ? std::lower_bound(begin, cell.cend(), static_cast<quint32>(last))
+                                               : cell.cend();
+        return std::make_pair(begin, end);
+    };
+
+    // 先统计总数一次预留，再直接追加各格的范围，不构造临时容器
+    qsizetype total = 0;
+    for (int cy = topLeft.y(); cy <= bottomRight.y(); ++cy) {
+        for (int cx = topLeft.x(); cx <= bottomRight.x(); ++cx) {
+            const auto [begin, end] = range(cx, cy);
+            total += end - begin;
+        }
+    }
+    if (total == 0)
+        return;
+    out.reserve(total);
+    int contributingCells = 0;
+    for (int cy = topLeft.y(); cy <= bottomRight.y(); ++cy) {
+        for (int cx = topLeft.x(); cx <= bottomRight.x(); ++cx) {
+            const auto [begin, end] = range(cx, cy);
+            if (begin == end)
+                continue;
+            std::copy(begin, end, std::back_inserter(out));
+            ++contributingCells;
+        }
+    }
+    // 各格内已升序，多格合并后排序，保证调用方的累加顺序确定
+    if (contributingCells > 1)
+        std::sort(out.begin(), out.end());
+}
+
+QVector<qsizetype> HeatMapSpatialIndex::pointsInRect(const HeatMapPointStore &points, const QRectF &rect,
+                                                     qsizetype first, qsizetype last) const
+{
+    QVector<quint32> indices;
+    candidates(rect, first, last, indices);
+    QVector<qsizetype> result;
+    for (quint32 index : std::as_const(indices)) {
+        const QPointF pos = points.at(index).pos;
+        if (pos.x() >= rect.left() && pos.x() <= rect.right() && pos.y() >= rect.top() && pos.y() <= rect.bottom())
+            result.append(index);
+    }
+    return result;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+
+#include <limits>
+
+#include "HeatMapPointStore.h"
+
+// 点击的均匀网格索引，按点的原始坐标（归一化坐标或背景像素坐标）划分，与控件尺寸、缩放视口无关。
+// 每格按下标升序记录落在其中的点，超出范围的点计入边缘格；追加的点增量加入，
+// 区域查询只访问与查询矩形相交的格。不加锁，由持有者在单一线程更新
+class HeatMapSpatialIndex
+{
+public:
+    static constexpr int kGridSize = 256; // 每边的格数
+
+    // 索引覆盖的坐标范围，变化时清空
+    void setBounds(const QRectF &bounds);
+    // 坐标范围没有固定上界时（如无背景的像素坐标）改用点的包围盒：新点落在范围外时
+    // 把范围扩大到包含它并向四周各延伸一半后重建，点数翻倍前通常不再重建
+    void setAutomaticBounds();
+    QRectF bounds() const { return m_bounds; }
+    // 丢弃全部索引；点数据被替换（而非追加）时须调用
+    void clear();
+    // 把 points 中尚未索引的点加入；点数少于已索引的点数时视为数据被替换并重建
+    void update(const HeatMapPointStore &points);
+    qsizetype indexedCount() const { return m_indexedCount; }
+
+    // 与 rect 相交的格中下标位于 [first, last) 的点，按下标升序写入 out（覆盖原内容）。
+    // 结果是候选集合，可能包含 rect 之外的点
+    void candidates(const QRectF &rect, qsizetype first, qsizetype last, QVector<quint32> &out) const;
+    // 坐标落在 rect 内（含边界）且下标位于 [first, last) 的点，按下标升序
+    QVector<qsizetype> pointsInRect(const HeatMapPointStore &points, const QRectF &rect, qsizetype first = 0,
+                                    qsizetype last = std::numeric_limits<qsizetype>::max()) const;
+
+private:
+    QPoint cellOf(const QPointF &pos) const;
+    void growBounds(const HeatMapPointStore &points);
+
+    QRectF m_bounds;
+    bool m_automaticBounds = false;
+    QVector<QVector<quint32>> m_cells; // kGridSize × kGridSize，首次 update() 时分配
+    qsizetype m_indexedCount = 0;
+};
@@ -0,0 +1,515 @@
+#include "HeatMapTileCache.h"
+
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QThreadPool>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 内容区域在视口中的像素矩形：两端分别取整，相邻瓦片恰好相接，不留缝隙
+QRect tileTarget(const QTransform &transform, const QRectF &content)
+{
+    const QRectF mapped = transform.mapRect(content);
+    return QRect(QPoint(qRound(mapped.left()), qRound(mapped.top())),
+                 QPoint(qRound(mapped.right()) - 1, qRound(mapped.bottom()) - 1));
+}
+
+// 按块顺序解码 [first, last) 的点并逐个处理，解码缓冲在栈上
+template <typename Fn>
+void forEachPoint(const HeatMapPointStore &points, qsizetype first, qsizetype last, Fn &&fn)
+{
+    HeatMapPoint chunk[HeatMapPointStore::kDecodeChunk];
+    for (qsizetype begin = first; begin < last; begin += HeatMapPointStore::kDecodeChunk) {
+        const qsizetype count = qMin(HeatMapPointStore::kDecodeChunk, last - begin);
+        points.decode(begin, count, chunk);
+        for (qsizetype i = 0; i < count; ++i)
+            fn(chunk[i]);
+    }
+}
+
+// 候选下标间隔不超过该值时并入同一段解码，多解码的少量点比逐点定位数据块更省
+constexpr quint32 kCandidateGap = 8;
+
+// 按升序下标处理候选点：把相近的下标合并为连续段整段解码，不逐点调用 at()
+template <typename Fn>
+void forEachCandidate(const HeatMapPointStore &points, const QVector<quint32> &candidates, Fn &&fn)
+{
+    HeatMapPoint chunk[HeatMapPointStore::kDecodeChunk];
+    for (qsizetype i = 0; i < candidates.size();) {
+        const quint32 first = candidates.at(i);
+        qsizetype j = i + 1;
+        while (j < candidates.size() && candidates.at(j) - candidates.at(j - 1) <= kCandidateGap
+               && candidates.at(j) - first < HeatMapPointStore::kDecodeChunk)
+            ++j;
+        points.decode(first, candidates.at(j - 1) - first + 1, chunk);
+        for (; i < j; ++i)
+            fn(chunk[candidates.at(i) - first]);
+    }
+}
+
+} // namespace
+
+QTransform HeatMapTileCache::Viewport::transform() const
+{
+    return QTransform::fromScale(zoom, zoom) * QTransform::fromTranslate(-pan.x() * zoom, -pan.y() * zoom);
+}
+
+HeatMapTileCache::HeatMapTileCache() = default;
+
+HeatMapTileCache::~HeatMapTileCache() = default;
+
+void HeatMapTileCache::clear()
+{
+    m_tiles.clear();
+}
+
+void HeatMapTileCache::setParams(const HeatMapRenderParams &params, bool radiusScalesWithZoom)
+{
+    const qreal displayRadius = HeatMapRenderer::displayRadius(params);
+    const bool densityChanged = params.size != m_params.size || params.displayRect != m_params.displayRect
+                                || params.normalizedCoordinates != m_params.normalizedCoordinates
+                                || params.baseImageSize != m_params.baseImageSize
+                                || params.falloff != m_params.falloff
+                                || params.densityMethod != m_params.densityMethod
+                                || params.timeMode != m_params.timeMode
+                                || params.decayHalfLife != m_params.decayHalfLife
+                                || displayRadius != m_displayRadius
+                                || radiusScalesWithZoom != m_radiusScalesWithZoom;
+    if (densityChanged)
+        clear();
+    m_params = params;
+    m_displayRadius = qMax<qreal>(1.0, displayRadius);
+    m_radiusScalesWithZoom = radiusScalesWithZoom;
+}
+
+void HeatMapTileCache::setColoring(const Coloring &coloring)
+{
+    // 归一化系数或调色板变化只需重新查表，衰减时间基准变化由瓦片自行判断是否重算密度
+    if (coloring.normalizeScale != m_coloring.normalizeScale || coloring.palette != m_coloring.palette)
+        ++m_colorVersion;
+    m_coloring = coloring;
+}
+
+void HeatMapTileCache::setBaseImage(const QImage &image, const QRectF &targetRect)
+{
+    if (image.cacheKey() == m_baseImage.cacheKey() && targetRect == m_baseRect)
+        return;
+    m_baseImage = image;
+    m_baseRect = targetRect;
+    m_backgroundTiles.clear();
+}
+
+int HeatMapTileCache::backgroundLevel(qreal zoom) const
+{
+    int level = zoom > 1.0 ? static_cast<int>(std::ceil(std::log2(zoom) - 1e-9)) : 0;
+    if (!m_baseImage.isNull() && !m_baseRect.isEmpty()) {
+        // 每个内容像素对应的原图像素数
+        const qreal density = qMax(m_baseImage.width() / m_baseRect.width(), m_baseImage.height() / m_baseRect.height());
+        const int nativeLevel = density > 1.0 ? static_cast<int>(std::ceil(std::log2(density) - 1e-9)) : 0;
+        level = qMin(level, nativeLevel);
+    }
+    return qBound(0, level, kMaxLevel);
+}
+
+int HeatMapTileCache::levelForZoom(qreal zoom) const
+{
+    int level = zoom > 1.0 ? static_cast<int>(std::ceil(std::log2(zoom) - 1e-9)) : 0;
+    level = qBound(0, level, kMaxLevel);
+    if (m_radiusScalesWithZoom) {
+        while (level > 0 && m_displayRadius * (1 << level) > kMaxTileRadius)
+            --level;
+    }
+    return level;
+}
+
+qreal HeatMapTileCache::levelRadius(int level) const
+{
+    return m_radiusScalesWithZoom ? m_displayRadius * (1 << level) : m_displayRadius;
+}
+
+quint64 HeatMapTileCache::tileKey(int level, int x, int y)
+{
+    return (quint64(level) << 56) | (quint64(x & 0xfffffff) << 28) | quint64(y & 0xfffffff);
+}
+
+QRect HeatMapTileCache::visibleTiles(const QSize &viewSize, const Viewport &viewport, int level) const
+{
+    const qreal scale = (1 << level);
+    const QRectF view(viewport.pan, QSizeF(viewSize) / viewport.zoom);
+    const QRectF content = view & QRectF(QPointF(0, 0), QSizeF(m_params.size));
+    if (content.isEmpty())
+        return QRect();
+    const int left = static_cast<int>(std::floor(content.left() * scale / kTileSize));
+    const int top = static_cast<int>(std::floor(content.top() * scale / kTileSize));
+    const int right = static_cast<int>(std::ceil(content.right() * scale / kTileSize)) - 1;
+    const int bottom = static_cast<int>(std::ceil(content.bottom() * scale / kTileSize)) - 1;
+    return QRect(QPoint(left, top), QPoint(qMax(left, right), qMax(top, bottom)));
+}
+
+bool HeatMapTileCache::tileNeedsWork(const Tile &tile, const HeatMapPointStore &points, qsizetype windowBegin) const
+{
+    if (!tile.densityValid || tile.stampedCount != HeatMapRenderer::pointEnd(m_params, points)
+        || tile.windowBegin != windowBegin)
+        return true;
+    return m_params.timeMode == HeatMapRenderParams::TimeMode::ExponentialDecay
+           && tile.decayOrigin != m_coloring.decayOrigin;
+}
+
+bool HeatMapTileCache::canUpdateIncrementally(const Tile &tile, const HeatMapPointStore &points,
+                                              qsizetype windowBegin) const
+{
+    // 分箱瓦片、衰减基准变化或一次进出大批点时整块重算；回放向后跳转时扣除回放位置之后的点
+    if (!tile.densityValid || tile.binned || windowBegin < tile.windowBegin)
+        return false;
+    if (m_params.timeMode == HeatMapRenderParams::TimeMode::ExponentialDecay
+        && tile.decayOrigin != m_coloring.decayOrigin)
+        return false;
+    const qsizetype end = HeatMapRenderer::pointEnd(m_params, points);
+    return qAbs(end - tile.stampedCount) + (windowBegin - tile.windowBegin) <= kIncrementalPointLimit;
+}
+
+HeatMapPointMapping HeatMapTileCache::tileMapping(int level, int x, int y) const
+{
+    const qreal scale = (1 << level);
+    HeatMapPointMapping mapping = HeatMapRenderer::displayMapping(m_params);
+    mapping.scaleX *= scale;
+    mapping.scaleY *= scale;
+    mapping.offsetX = mapping.offsetX * scale - x * kTileSize;
+    mapping.offsetY = mapping.offsetY * scale - y * kTileSize;
+    return mapping;
+}
+
+void HeatMapTileCache::renderTile(int level, int x, int y, Tile &tile, const HeatMapPointStore &points,
+                                  const HeatMapSpatialIndex &index, qsizetype windowBegin, bool binned,
+                                  TileScratch &scratch)
+{
+    HeatMapKernels::KernelStamp &stamp = m_stamps[level];
+    const qreal scale = (1 << level);
+    const qreal sigma = stamp.equivalentSigma();
+    const int binMargin = binned ? static_cast<int>(std::ceil(3 * sigma)) + 1 : 0;
+    const int reach = qMax(stamp.extent(), binMargin) + 1;
+
+    // 候选点：瓦片外扩核覆盖范围后换算回点坐标，由索引取出仍在窗口内的点
+    const qreal margin = reach / scale;
+    const QRectF query = QRectF(x * kTileSize / scale, y * kTileSize / scale, kTileSize / scale, kTileSize / scale)
+                             .adjusted(-margin, -margin, margin, margin);
+    QVector<quint32> &candidates = scratch.candidates;
+    index.candidates(QRectF(HeatMapRenderer::mapFromDisplay(m_params, query.topLeft()),
+                            HeatMapRenderer::mapFromDisplay(m_params, query.bottomRight())),
+                     windowBegin, HeatMapRenderer::pointEnd(m_params, points), candidates);
+
+    const HeatMapPointMapping mapping = tileMapping(level, x, y);
+    tile.density.resize(kTileSize * kTileSize);
+    if (!binned) {
+        std::fill(tile.density.begin(), tile.density.end(), 0.0f);
+        const QRect clip(0, 0, kTileSize, kTileSize);
+        HeatMapRenderer::withPeakFunction(m_params, m_coloring.decayOrigin, [&](auto peakOf) {
+            forEachCandidate(points, candidates, [&](const HeatMapPoint &point) {
+                stamp.stamp(tile.density.data(), kTileSize, mapping.map(point.pos), peakOf(point), clip);
+            });
+        });
+    } else {
+        // 外扩 3σ 分箱后模糊，再裁出瓦片本身，保证瓦片边缘与相邻瓦片连续
+        const int width = kTileSize + 2 * binMargin;
+        QVector<float> &bins = scratch.bins;
+        bins.resize(static_cast<qsizetype>(width) * width);
+        std::fill(bins.begin(), bins.end(), 0.0f);
+        const float mass = stamp.mass();
+        HeatMapRenderer::withPeakFunction(m_params, m_coloring.decayOrigin, [&](auto peakOf) {
+            forEachCandidate(points, candidates, [&](const HeatMapPoint &point) {
+                HeatMapKernels::splatBilinear(bins.data(), width, width,
+                                              mapping.map(point.pos) + QPointF(binMargin, binMargin),
+                                              peakOf(point) * mass);
+            });
+        });
+        HeatMapKernels::gaussianBlur(bins.data(), width, width, sigma, scratch.blur);
+        for (int row = 0; row < kTileSize; ++row)
+            std::copy_n(bins.constData() + static_cast<qsizetype>(row + binMargin) * width + binMargin, kTileSize,
+                        tile.density.data() + static_cast<qsizetype>(row) * kTileSize);
+    }
+
+    tile.stampedCount = HeatMapRenderer::pointEnd(m_params, points);
+    tile.windowBegin = windowBegin;
+    tile.decayOrigin = m_coloring.decayOrigin;
+    tile.binned = binned;
+    tile.densityValid = true;
+    tile.colorVersion = 0;
+}
+
+void HeatMapTileCache::updateTileIncrementally(int level, int x, int y, Tile &tile, const HeatMapPointStore &points,
+                                               qsizetype windowBegin)
+{
+    // 与整幅渲染的增量更新相同：滑出窗口的点扣除并截断负残差，新增点叠加；核覆盖不到的点由裁剪直接跳过
+    HeatMapKernels::KernelStamp &stamp = m_stamps[level];
+    const QRect clip(0, 0, kTileSize, kTileSize);
+    const HeatMapPointMapping mapping = tileMapping(level, x, y);
+    const qsizetype end = HeatMapRenderer::pointEnd(m_params, points);
+    float *density = tile.density.data();
+    QRect changed;
+    HeatMapRenderer::withPeakFunction(m_params, m_coloring.decayOrigin, [&](auto peakOf) {
+        auto subtract = [&](const HeatMapPoint &point) {
+            changed |= stamp.stamp(density, kTileSize, mapping.map(point.pos), -peakOf(point), clip);
+        };
+        forEachPoint(points, tile.windowBegin, qMin(windowBegin, tile.stampedCount), subtract);
+        forEachPoint(points, qMax(windowBegin, end), tile.stampedCount, subtract);
+        for (int row = changed.top(); row <= changed.bottom(); ++row) {
+            float *line = density + static_cast<qsizetype>(row) * kTileSize + changed.left();
+            std::replace_if(line, line + changed.width(), [](float value) { return value < 0.0f; }, 0.0f);
+        }
+        forEachPoint(points, qMax(windowBegin, tile.stampedCount), end, [&](const HeatMapPoint &point) {
+            changed |= stamp.stamp(density, kTileSize, mapping.map(point.pos), peakOf(point), clip);
+        });
+    });
+    tile.stampedCount = end;
+    tile.windowBegin = windowBegin;
+    if (!changed.isEmpty())
+        tile.colorVersion = 0;
+}
+
+void HeatMapTileCache::colorizeTile(Tile &tile) const
+{
+    if (tile.colorVersion == m_colorVersion && !tile.image.isNull())
+        return;
+    if (tile.image.isNull())
+        tile.image = QImage(kTileSize, kTileSize, QImage::Format_ARGB32_Premultiplied);
+
+    const int paletteSize = static_cast<int>(m_coloring.palette.size());
+    const float indexScale = m_coloring.normalizeScale * (paletteSize - 1);
+    for (int row = 0; row < kTileSize; ++row)
+        HeatMapKernels::colorize(tile.density.constData() + static_cast<qsizetype>(row) * kTileSize,
+                                 reinterpret_cast<QRgb *>(tile.image.scanLine(row)), kTileSize, indexScale,
+                                 m_coloring.palette.constData(), paletteSize);
+    tile.colorVersion = m_colorVersion;
+}
+
+void HeatMapTileCache::drawBaseImage(QPainter &painter, const QRectF &content) const
+{
+    const qreal scaleX = m_baseImage.width() / m_baseRect.width();
+    const qreal scaleY = m_baseImage.height() / m_baseRect.height();
+    const QRectF target = content.adjusted(-1 / scaleX, -1 / scaleY, 1 / scaleX, 1 / scaleY) & m_baseRect;
+    if (target.isEmpty())
+        return;
+    const QRectF source((target.left() - m_baseRect.left()) * scaleX, (target.top() - m_baseRect.top()) * scaleY,
+                        target.width() * scaleX, target.height() * scaleY);
+    painter.drawImage(target, m_baseImage, source);
+}
+
+void HeatMapTileCache::renderBackgroundTile(int level, int x, int y, BackgroundTile &tile) const
+{
+    const qreal scale = (1 << level);
+    tile.image = QImage(kTileSize, kTileSize, QImage::Format_ARGB32_Premultiplied);
+    tile.image.fill(Qt::transparent);
+    QPainter painter(&tile.image);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+    painter.setTransform(QTransform::fromScale(scale, scale) * QTransform::fromTranslate(-x * kTileSize, -y * kTileSize));
+    drawBaseImage(painter, QRectF(x * kTileSize / scale, y * kTileSize / scale, kTileSize / scale, kTileSize / scale));
+}
+
+bool HeatMapTileCache::updateBackground(const QSize &viewSize, const Viewport &viewport, const QElapsedTimer &timer,
+                                        int budgetMs)
+{
+    if (m_baseImage.isNull() || m_baseRect.isEmpty())
+        return true;
+    const int level = backgroundLevel(viewport.zoom);
+    const QRect visible = visibleTiles(viewSize, viewport, level);
+    if (visible.isEmpty())
+        return true;
+
+    const qreal scale = (1 << level);
+    const QPointF center = (viewport.pan + QPointF(viewSize.width(), viewSize.height()) / (2 * viewport.zoom))
+                           * scale / kTileSize;
+    QVector<QPoint> &pending = m_pendingBackground;
+    pending.clear();
+    for (int y = visible.top(); y <= visible.bottom(); ++y) {
+        for (int x = visible.left(); x <= visible.right(); ++x) {
+            BackgroundTile &tile = m_backgroundTiles[tileKey(level, x, y)];
+            tile.lastUsed = ++m_useCounter;
+            if (tile.image.isNull())
+                pending.append(QPoint(x, y));
+        }
+    }
+    evict(m_backgroundTiles, visible, level);
+    auto distance = [&](const QPoint &tile) {
+        const QPointF offset = QPointF(tile.x() + 0.5, tile.y() + 0.5) - center;
+        return offset.x() * offset.x() + offset.y() * offset.y();
+    };
+    std::sort(pending.begin(), pending.end(),
+              [&](const QPoint &a, const QPoint &b) { return distance(a) < distance(b); });
+
+    const int batch = m_pool ? qMax(1, m_pool->maxThreadCount()) : 1;
+    for (qsizetype next = 0; next < pending.size(); next += batch) {
+        if (next > 0 && timer.elapsed() >= budgetMs)
+            return false;
+        const int count = static_cast<int>(qMin<qsizetype>(batch, pending.size() - next));
+        QVector<BackgroundTile *> &tiles = m_batchBackgroundTiles;
+        tiles.resize(count);
+        for (int i = 0; i < count; ++i)
+            tiles[i] = &m_backgroundTiles[tileKey(level, pending.at(next + i).x(), pending.at(next + i).y())];
+        HeatMapKernels::parallelFor(count > 1 ? m_pool : nullptr, count, [&](int i) {
+            const QPoint &work = pending.at(next + i);
+            renderBackgroundTile(level, work.x(), work.y(), *tiles.at(i));
+        });
+    }
+    return true;
+}
+
+template <typename Tiles>
+void HeatMapTileCache::evict(Tiles &tiles, const QRect &visible, int level)
+{
+    if (tiles.size() <= m_capacity)
+        return;
+
+    QVector<QPair<quint64, quint64>> &candidates = m_evictionCandidates;
+    candidates.clear();
+    for (auto it = tiles.cbegin(); it != tiles.cend(); ++it) {
+        const int tileLevel = static_cast<int>(it.key() >> 56);
+        const QPoint position(static_cast<int>((it.key() >> 28) & 0xfffffff), static_cast<int>(it.key() & 0xfffffff));
+        if (tileLevel != level || !visible.contains(position))
+            candidates.append(qMakePair(it.value().lastUsed, it.key()));
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (const auto &candidate : std::as_const(candidates)) {
+        if (tiles.size() <= m_capacity)
+            break;
+        tiles.remove(candidate.second);
+    }
+}
+
+bool HeatMapTileCache::update(const QSize &viewSize, const Viewport &viewport, const HeatMapPointStore &points,
+                              const HeatMapSpatialIndex &index, int budgetMs)
+{
+    if (viewSize.isEmpty() || m_params.size.isEmpty())
+        return true;
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!updateBackground(viewSize, viewport, timer, budgetMs))
+        return false;
+    // 整幅渲染尚未给出调色板前无法着色，先显示整幅热力图
+    if (m_coloring.palette.isEmpty())
+        return true;
+    const qsizetype windowBegin = m_params.timeMode == HeatMapRenderParams::TimeMode::SlidingWindow
+                                      ? points.lowerBoundTimestamp(m_params.windowStart)
+                                      : 0;
+    const int level = levelForZoom(viewport.zoom);
+    const QRect visible = visibleTiles(viewSize, viewport, level);
+    if (visible.isEmpty())
+        return true;
+
+    // 核印章在并行前生成全部相位，之后各瓦片只读共享
+    HeatMapKernels::KernelStamp &stamp = m_stamps[level];
+    stamp.configure(levelRadius(level), m_params.falloff);
+    stamp.buildAllPhases();
+    stamp.mass();
+
+    // 同一级别统一选择叠加或分箱，避免相邻瓦片方式不同产生接缝；自动模式按平均每个瓦片的叠加开销判断
+    bool binned = m_params.densityMethod == HeatMapRenderParams::DensityMethod::Binned;
+    if (m_params.densityMethod == HeatMapRenderParams::DensityMethod::Automatic) {
+        const qreal scale = (1 << level);
+        const qreal levelTiles = qMax<qreal>(1.0, m_params.size.width() * scale / kTileSize)
+                                 * qMax<qreal>(1.0, m_params.size.height() * scale / kTileSize);
+        const qint64 kernelPixels = qMin<qint64>(qint64(2 * stamp.extent() + 1) * (2 * stamp.extent() + 1),
+                                                 kTileSize * kTileSize);
+        binned = (HeatMapRenderer::pointEnd(m_params, points) - windowBegin) / levelTiles * kernelPixels > kStampBudget;
+    }
+
+    QVector<Pending> &pending = m_pending;
+    pending.clear();
+    const qreal scale = (1 << level);
+    const QPointF center = (viewport.pan + QPointF(viewSize.width(), viewSize.height()) / (2 * viewport.zoom))
+                           * scale / kTileSize;
+    for (int y = visible.top(); y <= visible.bottom(); ++y) {
+        for (int x = visible.left(); x <= visible.right(); ++x) {
+            const quint64 key = tileKey(level, x, y);
+            Tile &tile = m_tiles[key];
+            tile.lastUsed = ++m_useCounter;
+            if (tileNeedsWork(tile, points, windowBegin) || tile.colorVersion != m_colorVersion) {
+                const QPointF offset = QPointF(x + 0.5, y + 0.5) - center;
+                pending.append({key, x, y, offset.x() * offset.x() + offset.y() * offset.y()});
+            }
+        }
+    }
+    evict(m_tiles, visible, level);
+    std::sort(pending.begin(), pending.end(),
+              [](const Pending &a, const Pending &b) { return a.distance < b.distance; });
+
+    // 每批交给线程池并行计算，批次之间检查时间预算；视口中心的瓦片最先完成
+    const int batch = m_pool ? qMax(1, m_pool->maxThreadCount()) : 1;
+    if (m_scratch.size() < batch)
+        m_scratch.resize(batch);
+    TileScratch *scratch = m_scratch.data();
+    for (qsizetype next = 0; next < pending.size(); next += batch) {
+        if (next > 0 && timer.elapsed() >= budgetMs)
+            return false;
+        const int count = static_cast<int>(qMin<qsizetype>(batch, pending.size() - next));
+        QVector<Tile *> &tiles = m_batchTiles;
+        tiles.resize(count);
+        for (int i = 0; i < count; ++i)
+            tiles[i] = &m_tiles[pending.at(next + i).key];
+        HeatMapKernels::parallelFor(count > 1 ? m_pool : nullptr, count, [&](int i) {
+            const Pending &work = pending.at(next + i);
+            Tile &tile = *tiles.at(i);
+            if (tileNeedsWork(tile, points, windowBegin)) {
+                if (canUpdateIncrementally(tile, points, windowBegin))
+                    updateTileIncrementally(level, work.x, work.y, tile, points, windowBegin);
+                else
+                    renderTile(level, work.x, work.y, tile, points, index, windowBegin, binned, scratch[i]);
+            }
+            colorizeTile(tile);
+        });
+    }
+    return true;
+}
+
+void HeatMapTileCache::draw(QPainter &painter, const QSize &viewSize, const Viewport &viewport, const QImage &fallback,
+                            qreal opacity) const
+{
+    const QTransform transform = viewport.transform();
+    painter.save();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+
+    if (!m_baseImage.isNull() && !m_baseRect.isEmpty()) {
+        const int level = backgroundLevel(viewport.zoom);
+        const QRect visible = visibleTiles(viewSize, viewport, level);
+        const qreal scale = (1 << level);
+        for (int y = visible.top(); y <= visible.bottom(); ++y) {
+            for (int x = visible.left(); x <= visible.right(); ++x) {
+                const QRectF content(x * kTileSize / scale, y * kTileSize / scale, kTileSize / scale, kTileSize / scale);
+                const auto it = m_backgroundTiles.constFind(tileKey(level, x, y));
+                if (it != m_backgroundTiles.cend() && !it->image.isNull()) {
+                    painter.drawImage(tileTarget(transform, content), it->image);
+                } else {
+                    painter.save();
+                    painter.setTransform(transform);
+                    painter.setClipRect(content);
+                    drawBaseImage(painter, content);
+                    painter.restore();
+                }
+            }
+        }
+    }
+
+    const int level = levelForZoom(viewport.zoom);
+    const QRect visible = visibleTiles(viewSize, viewport, level);
+    const qreal scale = (1 << level);
+    const qreal fallbackScaleX = m_params.size.isEmpty() ? 1.0 : qreal(fallback.width()) / m_params.size.width();
+    const qreal fallbackScaleY = m_params.size.isEmpty() ? 1.0 : qreal(fallback.height()) / m_params.size.height();
+    painter.setOpacity(opacity);
+    for (int y = visible.top(); y <= visible.bottom(); ++y) {
+        for (int x = visible.left(); x <= visible.right(); ++x) {
+            const QRectF content(x * kTileSize / scale, y * kTileSize / scale, kTileSize / scale, kTileSize / scale);
+            const QRect target = tileTarget(transform, content);
+            const auto it = m_tiles.constFind(tileKey(level, x, y));
+            if (it != m_tiles.cend() && !it->image.isNull()) {
+                painter.drawImage(target, it->image);
+            } else if (!fallback.isNull()) {
+                const QRectF source(content.left() * fallbackScaleX, content.top() * fallbackScaleY,
+                                    content.width() * fallbackScaleX, content.height() * fallbackScaleY);
+                painter.drawImage(QRectF(target), fallback, source);
+            }
+        }
+    }
+    painter.restore();
+}
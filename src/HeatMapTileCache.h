@@ -0,0 +1,174 @@
+#pragma once
+
+#include <QHash>
+#include <QImage>
+#include <QPointF>
+#include <QRectF>
+#include <QSize>
+#include <QTransform>
+#include <QVector>
+
+#include "HeatMapKernels.h"
+#include "HeatMapPointStore.h"
+#include "HeatMapRenderer.h"
+#include "HeatMapSpatialIndex.h"
+
+class QElapsedTimer;
+class QPainter;
+class QThreadPool;
+
+// 缩放视口的分块渲染缓存，不依赖控件。
+// 视口把基准视图（缩放为 1 时的输出坐标，下称内容坐标）中的点 c 显示在 (c - pan) * zoom。
+// 缩放级别 level 下内容按 2^level 倍分辨率划分为 kTileSize 的瓦片，以 (level, x, y) 为键缓存
+// 瓦片的密度与着色结果：只计算视口内的瓦片，每个瓦片只处理核能覆盖到它的点（由 HeatMapSpatialIndex 剔除），
+// 平移时复用已渲染的瓦片。追加点击与滑动窗口前移按瓦片增量叠加或扣除。
+// 归一化系数、调色板与衰减时间基准取自整幅渲染（HeatMapRenderer），各级瓦片与整幅热力图颜色一致。
+// 背景同样按级别分块缓存，级别不超过背景原图的分辨率，放大与平移时不再逐帧从原图重采样。
+class HeatMapTileCache
+{
+public:
+    static constexpr int kTileSize = 256;
+    static constexpr int kMaxLevel = 5; // 最高按 32 倍分辨率计算
+
+    // 视口：zoom ≥ 1，pan 为视口左上角的内容坐标
+    struct Viewport
+    {
+        qreal zoom = 1.0;
+        QPointF pan;
+
+        // 内容坐标到视口坐标的变换
+        QTransform transform() const;
+    };
+
+    // 整幅渲染的归一化与着色方式，瓦片按相同方式查表
+    struct Coloring
+    {
+        float normalizeScale = 0.0f;
+        QVector<QRgb> palette;
+        qint64 decayOrigin = 0;
+    };
+
+    HeatMapTileCache();
+    ~HeatMapTileCache();
+
+    void setThreadPool(QThreadPool *pool) { m_pool = pool; }
+    // 缓存的瓦片数上限，超出时淘汰最久未使用的瓦片（视口内的瓦片不会被淘汰）
+    void setCapacity(int tiles) { m_capacity = qMax(1, tiles); }
+    int capacity() const { return m_capacity; }
+
+    // 丢弃全部瓦片；点数据被替换（而非追加）时须调用
+    void clear();
+
+    // 整幅渲染的参数。radiusScalesWithZoom 为真时半径随内容一同放大，否则保持屏幕像素不变，
+    // 放大后密集区域的点会彼此分开。影响密度的参数变化时自动清空缓存
+    void setParams(const HeatMapRenderParams &params, bool radiusScalesWithZoom);
+    void setColoring(const Coloring &coloring);
+    // 背景原图及其在内容坐标中的绘制区域，变化时丢弃背景瓦片；空图表示无背景
+    void setBaseImage(const QImage &image, const QRectF &targetRect);
+
+    // 视口所用的缩放级别：不超过 kMaxLevel；半径随缩放时，放大后的半径超过 kMaxTileRadius
+    // 的级别不再细分（密度在该尺度上已足够平滑），改为放大显示较低级别的瓦片
+    int levelForZoom(qreal zoom) const;
+
+    // 计算视口内缺失或过期的背景与热力瓦片，从视口中心向外，用时超过 budgetMs 后停止；
+    // 返回是否已全部完成，未完成时调用方应安排下一次绘制。index 须已更新到与 points 一致
+    bool update(const QSize &viewSize, const Viewport &viewport, const HeatMapPointStore &points,
+                const HeatMapSpatialIndex &index, int budgetMs);
+    // 按视口绘制背景瓦片与热力瓦片；尚未计算的背景瓦片直接从原图采样，
+    // 尚未计算的热力瓦片用 fallback（整幅热力图，拉伸到 params.size）的对应区域放大代替
+    void draw(QPainter &painter, const QSize &viewSize, const Viewport &viewport, const QImage &fallback,
+              qreal opacity) const;
+
+    qsizetype tileCount() const { return m_tiles.size(); }
+
+private:
+    struct Tile
+    {
+        QVector<float> density; // kTileSize × kTileSize
+        QImage image;           // 着色结果，未着色时为空
+        qsizetype stampedCount = 0;
+        qsizetype windowBegin = 0;
+        qint64 decayOrigin = 0;
+        bool binned = false;
+        bool densityValid = false;
+        quint64 colorVersion = 0;
+        quint64 lastUsed = 0;
+    };
+
+    struct BackgroundTile
+    {
+        QImage image;
+        quint64 lastUsed = 0;
+    };
+
+    // 待计算的瓦片及其到视口中心的距离（以瓦片计）
+    struct Pending
+    {
+        quint64 key;
+        int x;
+        int y;
+        qreal distance;
+    };
+
+    // 重算一个瓦片所用的临时缓冲，每批中的每个任务各用一份，跨帧复用
+    struct TileScratch
+    {
+        QVector<quint32> candidates;
+        QVector<float> bins;
+        HeatMapKernels::BlurScratch blur;
+    };
+
+    // 瓦片键：级别占高 8 位，x、y 各 28 位
+    static quint64 tileKey(int level, int x, int y);
+    QRect visibleTiles(const QSize &viewSize, const Viewport &viewport, int level) const;
+    qreal levelRadius(int level) const;
+    // 背景瓦片的级别：随缩放细分，但不超过背景原图的分辨率（再细分只是插值放大）
+    int backgroundLevel(qreal zoom) const;
+
+    bool tileNeedsWork(const Tile &tile, const HeatMapPointStore &points, qsizetype windowBegin) const;
+    bool canUpdateIncrementally(const Tile &tile, const HeatMapPointStore &points, qsizetype windowBegin) const;
+    void renderTile(int level, int x, int y, Tile &tile, const HeatMapPointStore &points,
+                    const HeatMapSpatialIndex &index, qsizetype windowBegin, bool binned, TileScratch &scratch);
+    void updateTileIncrementally(int level, int x, int y, Tile &tile, const HeatMapPointStore &points,
+                                 qsizetype windowBegin);
+    void colorizeTile(Tile &tile) const;
+    bool updateBackground(const QSize &viewSize, const Viewport &viewport, const QElapsedTimer &timer, int budgetMs);
+    void renderBackgroundTile(int level, int x, int y, BackgroundTile &tile) const;
+    // 背景原图在内容区域 content（外扩一个原图像素，保证瓦片边缘的双线性插值连续）上的部分
+    void drawBaseImage(QPainter &painter, const QRectF &content) const;
+    // 点坐标到瓦片 (level, x, y) 内像素坐标的映射
+    HeatMapPointMapping tileMapping(int level, int x, int y) const;
+    // 超出容量时按最近使用时间淘汰，视口内（level 级别、visible 范围）的瓦片保留
+    template <typename Tiles>
+    void evict(Tiles &tiles, const QRect &visible, int level);
+
+    HeatMapRenderParams m_params;
+    bool m_radiusScalesWithZoom = true;
+    qreal m_displayRadius = 25;       // 缩放为 1 时的半径（内容像素）
+    Coloring m_coloring;
+    quint64 m_colorVersion = 1;       // 着色方式每变化一次加一
+    QThreadPool *m_pool = nullptr;
+
+    QHash<quint64, Tile> m_tiles;
+    QImage m_baseImage;
+    QRectF m_baseRect;
+    QHash<quint64, BackgroundTile> m_backgroundTiles;
+    int m_capacity = 192;
+    quint64 m_useCounter = 0;
+    HeatMapKernels::KernelStamp m_stamps[kMaxLevel + 1];
+
+    // 逐帧的工作列表与每批的临时缓冲只在容量不足时扩容，稳态下的帧不分配内存
+    QVector<Pending> m_pending;
+    QVector<Tile *> m_batchTiles;
+    QVector<QPoint> m_pendingBackground;
+    QVector<BackgroundTile *> m_batchBackgroundTiles;
+    QVector<QPair<quint64, quint64>> m_evictionCandidates; // (lastUsed, key)
+    QVector<TileScratch> m_scratch;
+
+    // 核半径上限（瓦片像素），见 levelForZoom()
+    static constexpr qreal kMaxTileRadius = 128;
+    // 候选点数 × 单点叠加像素数超过该值时改为分箱模糊，瓦片开销与点数近乎无关
+    static constexpr qint64 kStampBudget = qint64(1) << 25;
+    // 超过该数量的进出点整块重算瓦片，而不是逐点增量
+    static constexpr qsizetype kIncrementalPointLimit = 4096;
+};
@@ -0,0 +1,240 @@
+// 批量离屏渲染热力图：按目录或清单并行处理多个会话，每个会话输出一张 PNG。
+// 与 HeatMapOverlay 共用渲染与合成实现，同尺寸下输出与控件逐像素一致。
+//
+// 用法：
+//   heatmap_render [--config config/heatmap_config.json] [--size 1920x1080] [--jobs N] [--output 目录] <目录或清单.json>
+// 目录：每张图片（png/jpg/jpeg/bmp）与同名的点击文件配对，优先 .hmcl 点击日志，其次 .csv
+//       （每行 x,y[,权重[,时间戳]]）；没有点击文件的图片跳过。
+// 清单：{"sessions": [{"image": "a.png", "clicks": "a.hmcl", "output": "a_heat.png"}, ...]}，
+//       相对路径相对清单所在目录，output 缺省时按图片名输出到 --output 目录。
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+#include <cstdio>
+
+#include "../src/HeatMapClickLog.h"
+#include "../src/HeatMapImageRenderer.h"
+
+namespace {
+
+struct Session
+{
+    QString image;
+    QString clicks;
+    QString output;
+};
+
+QMutex g_logMutex;
+
+void logError(const QString &message)
+{
+    QMutexLocker locker(&g_logMutex);
+    QTextStream(stderr) << message << "\n";
+}
+
+// CSV 点击文件：每行 x,y[,权重[,时间戳]]，无法解析的行（如表头、注释）跳过
+bool loadCsvClicks(const QString &path, HeatMapPointStore *points, QString *errorString)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *errorString = file.errorString();
+        return false;
+    }
+    points->clear();
+    while (!file.atEnd()) {
+        const QList<QByteArray> fields = file.readLine().trimmed().split(',');
+        if (fields.size() < 2)
+            continue;
+        bool okX = false;
+        bool okY = false;
+        HeatMapPoint point;
+        point.pos = QPointF(fields.at(0).trimmed().toDouble(&okX), fields.at(1).trimmed().toDouble(&okY));
+        if (!okX || !okY)
+            continue;
+        if (fields.size() > 2)
+            point.weight = qMax(0.01, fields.at(2).trimmed().toDouble());
+        if (fields.size() > 3)
+            point.timestamp = qMax(points->lastTimestamp(), fields.at(3).trimmed().toLongLong());
+        points->append(point);
+    }
+    return true;
+}
+
+QList<Session> sessionsFromDirectory(const QString &path, const QString &outputDir)
+{
+    QList<Session> sessions;
+    const QDir dir(path);
+    const QStringList filters = {QStringLiteral("*.png"), QStringLiteral("*.jpg"), QStringLiteral("*.jpeg"),
+                                 QStringLiteral("*.bmp")};
+    for (const QFileInfo &image : dir.entryInfoList(filters, QDir::Files, QDir::Name)) {
+        Session session;
+        session.image = image.absoluteFilePath();
+        for (const QString &suffix : {QStringLiteral(".hmcl"), QStringLiteral(".csv")}) {
+            const QString clicks = dir.absoluteFilePath(image.completeBaseName() + suffix);
+            if (QFile::exists(clicks)) {
+                session.clicks = clicks;
+                break;
+            }
+        }
+        if (session.clicks.isEmpty())
+            continue;
+        session.output = QDir(outputDir).absoluteFilePath(image.completeBaseName() + QStringLiteral(".png"));
+        sessions.append(session);
+    }
+    return sessions;
+}
+
+bool sessionsFromManifest(const QString &path, const QString &outputDir, QList<Session> *sessions, QString *errorString)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorString = file.errorString();
+        return false;
+    }
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+    if (!document.isObject()) {
+        *errorString = QStringLiteral("清单不是 JSON 对象");
+        return false;
+    }
+    const QDir base = QFileInfo(path).absoluteDir();
+    const QJsonArray entries = document.object().value(QStringLiteral("sessions")).toArray();
+    for (qsizetype i = 0; i < entries.size(); ++i) {
+        const QJsonObject entry = entries.at(i).toObject();
+        Session session;
+        session.image = base.absoluteFilePath(entry.value(QStringLiteral("image")).toString());
+        session.clicks = base.absoluteFilePath(entry.value(QStringLiteral("clicks")).toString());
+        const QString output = entry.value(QStringLiteral("output")).toString();
+        session.output = output.isEmpty()
+                             ? QDir(outputDir).absoluteFilePath(QFileInfo(session.image).completeBaseName()
+                                                                + QStringLiteral(".png"))
+                             : base.absoluteFilePath(output);
+        sessions->append(session);
+    }
+    return true;
+}
+
+bool renderSession(const Session &session, const HeatMapRenderConfig &config, const QSize &size, QThreadPool *pool)
+{
+    const QImage baseImage(session.image);
+    if (baseImage.isNull()) {
+        logError(QStringLiteral("%1：无法读取背景图片").arg(session.image));
+        return false;
+    }
+
+    HeatMapPointStore points;
+    HeatMapRenderConfig sessionConfig = config;
+    QString error;
+    bool loaded = false;
+    if (session.clicks.endsWith(QStringLiteral(".hmcl"), Qt::CaseInsensitive)) {
+        // 点击日志自带坐标模式，内存映射后直接渲染
+        HeatMapClickLog::Info info;
+        loaded = HeatMapClickLog::load(session.clicks, &points, &info, &error);
+        sessionConfig.normalizedCoordinates = info.normalizedCoordinates;
+    } else {
+        loaded = loadCsvClicks(session.clicks, &points, &error);
+    }
+    if (!loaded) {
+        logError(QStringLiteral("%1：%2").arg(session.clicks, error));
+        return false;
+    }
+
+    // 每个会话一个渲染器，密度计算借用线程池中空闲的线程
+    HeatMapImageRenderer renderer(sessionConfig);
+    renderer.setThreadPool(pool);
+    const QImage image = renderer.render(baseImage, points, size);
+    QDir().mkpath(QFileInfo(session.output).absolutePath());
+    if (!image.save(session.output, "PNG")) {
+        logError(QStringLiteral("%1：写入失败").arg(session.output));
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("heatmap_render"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("批量离屏渲染点击热力图"));
+    parser.addHelpOption();
+    const QCommandLineOption configOption(QStringLiteral("config"), QStringLiteral("渲染配置 JSON"), QStringLiteral("file"));
+    const QCommandLineOption sizeOption(QStringLiteral("size"), QStringLiteral("输出尺寸 WxH，缺省为背景尺寸"),
+                                        QStringLiteral("size"));
+    const QCommandLineOption jobsOption(QStringLiteral("jobs"), QStringLiteral("并行线程数，缺省为 CPU 核数"),
+                                        QStringLiteral("n"));
+    const QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("输出目录，缺省为输入目录下的 heatmaps"),
+                                          QStringLiteral("dir"));
+    parser.addOption(configOption);
+    parser.addOption(sizeOption);
+    parser.addOption(jobsOption);
+    parser.addOption(outputOption);
+    parser.addPositionalArgument(QStringLiteral("input"), QStringLiteral("会话目录或清单 JSON"));
+    parser.process(app);
+
+    const QStringList inputs = parser.positionalArguments();
+    if (inputs.size() != 1)
+        parser.showHelp(1);
+
+    HeatMapRenderConfig config;
+    QString error;
+    if (parser.isSet(configOption) && !HeatMapRenderConfig::load(parser.value(configOption), &config, &error)) {
+        logError(QStringLiteral("%1：%2").arg(parser.value(configOption), error));
+        return 1;
+    }
+
+    QSize size;
+    if (parser.isSet(sizeOption)) {
+        const QStringList parts = parser.value(sizeOption).split(QLatin1Char('x'));
+        if (parts.size() == 2)
+            size = QSize(parts.at(0).toInt(), parts.at(1).toInt());
+        if (size.isEmpty()) {
+            logError(QStringLiteral("无效的输出尺寸：%1").arg(parser.value(sizeOption)));
+            return 1;
+        }
+    }
+
+    const QFileInfo input(inputs.first());
+    const QString inputDir = input.isDir() ? input.absoluteFilePath() : input.absolutePath();
+    const QString outputDir = parser.isSet(outputOption) ? parser.value(outputOption)
+                                                         : QDir(inputDir).absoluteFilePath(QStringLiteral("heatmaps"));
+    QList<Session> sessions;
+    if (input.isDir()) {
+        sessions = sessionsFromDirectory(input.absoluteFilePath(), outputDir);
+    } else if (!sessionsFromManifest(input.absoluteFilePath(), outputDir, &sessions, &error)) {
+        logError(QStringLiteral("%1：%2").arg(input.absoluteFilePath(), error));
+        return 1;
+    }
+
+    // 会话之间并行；会话数少于核数时，单个会话的密度计算借用剩余的空闲线程
+    QThreadPool pool;
+    const int jobs = parser.isSet(jobsOption) ? parser.value(jobsOption).toInt() : QThread::idealThreadCount();
+    pool.setMaxThreadCount(qMax(1, jobs));
+    std::atomic<int> failures{0};
+    for (const Session &session : std::as_const(sessions)) {
+        pool.start([&, session]() {
+            if (!renderSession(session, config, size, &pool))
+                failures.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+    pool.waitForDone();
+
+    QTextStream(stdout) << sessions.size() - failures.load() << "/" << sessions.size() << " 个会话已输出到 " << outputDir
+                        << "\n";
+    return failures.load() == 0 ? 0 : 1;
+}